@@ -15,8 +15,18 @@
 #include <numeric>
 #include <fstream>
 #include <cassert>
+#include <thread>
+#include <limits>
+#include <random>
 #include <unistd.h>
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 #include <Sort\Sort.h>
+#include <Sort\ExternalSort.h>
 
 
 using namespace std;
@@ -34,6 +44,13 @@ struct sor_algorithms {
     Function algorithm;
 } ;
 
+/// ----------------------------------------------------------------------------
+///                      Global Variables
+/// ----------------------------------------------------------------------------
+
+// Tasks stolen by each worker during the last parallel quick sort run
+static std::vector<std::size_t> quickSteals;
+
 /// ----------------------------------------------------------------------------
 ///                      Prototype Function(s)
 /// ----------------------------------------------------------------------------
@@ -41,20 +58,41 @@ void test_runs();
 void gen_header();
 bool user_process(int option);
 void run_benchmark(int start, int end);
+void run_thread_sweep(int size);
+void run_multiway_sweep(int size);
+void run_cache_sweep(int size);
+void run_external_sort(int size, const ExternalSort::Options& options);
+void run_mapped_sort(int size);
+bool write_keys(const std::string& path, int size);
+bool check_keys(const std::string& path, int size);
 bool print_benchmark(int start, int end);
 void randFill (std::vector<int>& vector);
 double measure(std::vector<int>& vector, const Function& function);
+long long measure_misses(std::vector<int>& vector, const Function& function, double& seconds);
 
 // Inline function declarations
-inline void bubbleSort(std::vector<int>& vector) { Sort::bubble_sort(vector); }
-inline void selectionSort(std::vector<int>& vector) { Sort::insertion_sort(vector); }
-inline void insertionSort(std::vector<int>& vector) { Sort::selection_sort(vector); }
-inline void mergeSort(std::vector<int>& vector) { Sort::merge_sort(vector, 0, vector.size() -1);}
-inline void quickSort(std::vector<int>& vector) { Sort::quick_sort(vector, 0, vector.size() -1);}
+inline void bubbleSort(std::vector<int>& vector) { Sort::bubble_sort(vector.begin(), vector.end()); }
+inline void selectionSort(std::vector<int>& vector) { Sort::selection_sort(vector.begin(), vector.end()); }
+inline void insertionSort(std::vector<int>& vector) { Sort::insertion_sort(vector.begin(), vector.end()); }
+inline void mergeSort(std::vector<int>& vector) { Sort::merge_sort(vector.begin(), vector.end());}
+inline void bottomUpSort(std::vector<int>& vector) { Sort::merge_sort_bottom_up(vector.begin(), vector.end());}
+inline void tiledSort(std::vector<int>& vector) { Sort::tiled_merge_sort(vector.begin(), vector.end());}
+inline void timSort(std::vector<int>& vector) { Sort::tim_sort(vector.begin(), vector.end());}
+inline void quickSort(std::vector<int>& vector) { Sort::quick_sort(vector.begin(), vector.end());}
+inline void introSort(std::vector<int>& vector) { Sort::intro_sort(vector.begin(), vector.end());}
+inline void introSimdSort(std::vector<int>& vector) { Sort::intro_sort(vector.begin(), vector.end(), Sort::Partition::simd);}
+inline void pdqSort(std::vector<int>& vector) { Sort::pdq_sort(vector.begin(), vector.end());}
+inline void parallelMergeSort(std::vector<int>& vector) { Sort::parallel_merge_sort(vector.begin(), vector.end());}
+inline void parallelQuickSort(std::vector<int>& vector) { quickSteals = Sort::parallel_quick_sort(vector.begin(), vector.end());}
+inline void parallelRadixSort(std::vector<int>& vector) { Sort::parallel_radix_sort(vector.begin(), vector.end());}
+inline void parallelSampleSort(std::vector<int>& vector) { Sort::parallel_sample_sort(vector.begin(), vector.end());}
+inline void radixSort(std::vector<int>& vector) { Sort::radix_sort(vector.begin(), vector.end());}
+inline void msdRadixSort(std::vector<int>& vector) { Sort::msd_radix_sort(vector.begin(), vector.end());}
 inline void std_sort (std::vector<int>& vector) {std::sort(vector.begin(),vector.end());}
 
 // Overload operator function
-std::ostream& operator<< (std::ostream& output, const std::vector<int>& vec);
+template <class T>
+std::ostream& operator<< (std::ostream& output, const std::vector<T>& vec);
 
 /// ----------------------------------------------------------------------------
 ///                      Global Constants
@@ -70,7 +108,19 @@ static const std::vector<sor_algorithms> ALGORITHMS = {
     {"Selection: ", &selectionSort},
     {"Insertion: ", &insertionSort},
     {"MergeSort: ", &mergeSort},
+    {"BottomUp:  ", &bottomUpSort},
+    {"Tiled:     ", &tiledSort},
+    {"ParMerge:  ", &parallelMergeSort},
+    {"TimSort:   ", &timSort},
     {"QuickSort: ", &quickSort},
+    {"IntroSort: ", &introSort},
+    {"IntroSimd: ", &introSimdSort},
+    {"PdqSort:   ", &pdqSort},
+    {"ParQuick:  ", &parallelQuickSort},
+    {"ParSample: ", &parallelSampleSort},
+    {"RadixSort: ", &radixSort},
+    {"MsdRadix:  ", &msdRadixSort},
+    {"ParRadix:  ", &parallelRadixSort},
     {"std::sort: ", &std_sort},
 };
 
@@ -80,9 +130,14 @@ static const std::vector<sor_algorithms> ALGORITHMS = {
 /// ----------------------------------------------------------------------------
 int main() {
     // Array of user options
-    const char* options[4] = {"Test Run", 
+    const char* options[9] = {"Test Run", 
                               "Run Benchmark", 
                               "Run Benchmark and Print Data",
+                              "Run Thread Scaling Benchmark",
+                              "Run Multiway Merge Benchmark",
+                              "Run Cache Sweep Benchmark",
+                              "Run External Sort",
+                              "Run Memory Mapped Sort",
                               "End The Program"};
     // Entry Prompt
     cout << "This program tests the following sorting algorithms:\n" + line;
@@ -98,7 +153,7 @@ int main() {
         cout << line + "Please select from the following options\n" + line;
 
         // List options
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < 9; i++) {
             cout << i + 1 << " => " << options[i] << '\n';
         }
 
@@ -109,12 +164,12 @@ int main() {
         int user = 0; 
         cin >> user;
 
-        if(user == 4) {
+        if(user == 9) {
             cout << "\nProgram ended.\n";
             break;
         }
-        else if(user > 0 && user < 4) {
-            assert(user > 0 && user < 4);
+        else if(user > 0 && user < 9) {
+            assert(user > 0 && user < 9);
             // Status for user to test again
             bool status = user_process(user);
             
@@ -143,6 +198,7 @@ bool user_process(int option){
     cout << line +"User Selected: " << option << '\n' << flush;
     int from = 0;       // Starting range
     int to = 0;         // End range
+    ExternalSort::Options external;     // External sort settings
     
     sleep(2);
 
@@ -199,6 +255,103 @@ bool user_process(int option){
                 cout << "Failed to generate file.\n";
             }
             
+            break;
+        // Option 4: Run thread scaling benchmark
+        case 4:
+            // Prompt user
+            cout << line;
+            cout << "Insert a vector size to randomly fill:\n";
+            cout << "\t0 > x > 2,147,488,647\n";
+            cout << "Note: Thread count will double until every hardware thread is used\n";
+            cout << "Ex:Size: 100000000\n" + line;
+            // Take input
+            cout << "\nSize: ";
+            cin >> from;
+
+            assert(from >= 0 && from <= 2147488647);
+            cout << '\n';
+            // Run thread sweep
+            run_thread_sweep(from);
+
+            break;
+        // Option 5: Run multiway merge benchmark
+        case 5:
+            // Prompt user
+            cout << line;
+            cout << "Insert a vector size to randomly fill:\n";
+            cout << "\t0 > x > 2,147,488,647\n";
+            cout << "Note: Runs merged per pass will double from 2 to 32\n";
+            cout << "Ex:Size: 100000000\n" + line;
+            // Take input
+            cout << "\nSize: ";
+            cin >> from;
+
+            assert(from >= 0 && from <= 2147488647);
+            cout << '\n';
+            // Run multiway sweep
+            run_multiway_sweep(from);
+
+            break;
+        // Option 6: Run cache sweep benchmark
+        case 6:
+            // Prompt user
+            cout << line;
+            cout << "Insert the largest vector size to randomly fill:\n";
+            cout << "\t0 > x > 2,147,488,647\n";
+            cout << "Note: Sizes will double from 65,536 up to the given size\n";
+            cout << "Ex:Size: 100000000\n" + line;
+            // Take input
+            cout << "\nSize: ";
+            cin >> from;
+
+            assert(from >= 0 && from <= 2147488647);
+            cout << '\n';
+            // Run cache sweep
+            run_cache_sweep(from);
+
+            break;
+        // Option 7: Run external sort
+        case 7:
+            // Prompt user
+            cout << line;
+            cout << "Insert the number of keys to write to a file and sort:\n";
+            cout << "\t0 > x > 2,147,488,647\n";
+            cout << "Note: Keys are 4 byte ints, memory budget is in MiB\n";
+            cout << "Ex:Size: 100000000  Memory: 64  Fan-in: 16  Temp: .\n" + line;
+            // Take input
+            cout << "\nSize: ";
+            cin >> from;
+            cout << "Memory: ";
+            cin >> to;
+            cout << "Fan-in: ";
+            cin >> external.fanIn;
+            cout << "Temp: ";
+            cin >> external.tempDir;
+
+            assert(from >= 0 && from <= 2147488647 && to > 0);
+            external.memoryBytes = static_cast<std::size_t>(to) << 20;
+            cout << '\n';
+            // Run external sort
+            run_external_sort(from, external);
+
+            break;
+        // Option 8: Run memory mapped sort
+        case 8:
+            // Prompt user
+            cout << line;
+            cout << "Insert the number of keys to write to a file and sort in place:\n";
+            cout << "\t0 > x > 2,147,488,647\n";
+            cout << "Note: Keys are 4 byte ints, the file is sorted through a memory mapping\n";
+            cout << "Ex:Size: 100000000\n" + line;
+            // Take input
+            cout << "\nSize: ";
+            cin >> from;
+
+            assert(from >= 0 && from <= 2147488647);
+            cout << '\n';
+            // Run mapped sort
+            run_mapped_sort(from);
+
             break;
 
         default:
@@ -234,7 +387,8 @@ void randFill (vector<int>& vector) {
 /// @param [in] vector The vector to print.
 /// @returns output The data from the vector.
 /// ----------------------------------------------------------------------------
-std::ostream& operator<< (std::ostream& output, const std::vector<int>& vector){
+template <class T>
+std::ostream& operator<< (std::ostream& output, const std::vector<T>& vector){
     // Space between each elements, the comma an space.
     char separator[] {'\0','\0'};
     // Prints the opening bracket.
@@ -270,6 +424,46 @@ double measure(std::vector<int>& vector, const Function& function) {
     return elapsed.count();
 }
 
+/// ----------------------------------------------------------------------------
+/// Measures a sorting algorithm along with the cache misses it causes.
+/// @param [in] vector The vector to sort.
+/// @param [in] function The sorting algorithm.
+/// @param [out] seconds Receives the elapsed time.
+/// @returns the last level cache misses counted by the hardware, or -1 when
+/// the platform or its permissions offer no counter.
+/// ----------------------------------------------------------------------------
+long long measure_misses(std::vector<int>& vector, const Function& function, double& seconds) {
+#ifdef __linux__
+    // Cache misses of this thread in user space
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    int counter = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        seconds = measure(vector, function);
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+        long long misses = -1;
+        if (read(counter, &misses, sizeof(misses)) != static_cast<ssize_t>(sizeof(misses))) {
+            misses = -1;
+        }
+        close(counter);
+        return misses;
+    }
+#endif
+    // No counter, time only
+    seconds = measure(vector, function);
+    return -1;
+}
+
 /// ----------------------------------------------------------------------------
 /// Test run of all sorting algorithm with a size 10 vector and no time.
 /// ----------------------------------------------------------------------------
@@ -302,6 +496,10 @@ void gen_header() {
     std::string DIV = "+---------+";                 ///< Header divider
     std::string DIV2 = "--------------+";            ///< Header divider
     cout << std::setprecision(6) << std::showpoint << std::fixed;
+    // Worker threads used by the parallel algorithms
+    cout << "\nThreads: " << ThreadPool::instance().size() << '\n';
+    // Vector kernels picked for this CPU, SORT_SIMD forces a lower tier
+    cout << "Kernel: " << Simd::kernel_name() << '\n';
     cout << '\n' << BAR[1] << CW << "Size: " << flush;
     
     // Print sorting algorithm names
@@ -329,6 +527,257 @@ void run_benchmark(int start, int end) {
         }
         cout << BAR << '\n';
     }
+
+    // Work stealing balance of the largest parallel quick sort run
+    cout << "\nParQuick steals per worker: " << quickSteals << '\n';
+}
+
+/// ----------------------------------------------------------------------------
+/// Runs parallel radix and sample sort on the same vector with a growing
+/// thread count.
+/// @param [in] size The vector size to sort.
+/// ----------------------------------------------------------------------------
+void run_thread_sweep(int size) {
+    std::vector<int> vector(size);
+    randFill(vector);
+
+    // Every hardware thread, at least one
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    double singleRadix = 0;     // Radix sort time on one thread
+    double singleSample = 0;    // Sample sort time on one thread
+
+    cout << std::setprecision(6) << std::showpoint << std::fixed;
+    cout << BAR[1] << CW << "Threads:" << BAR << CW2 << "ParRadix:" << BAR << CW2 << "Speedup:";
+    cout << BAR << CW2 << "ParSample:" << BAR << CW2 << "Speedup:" << BAR << '\n';
+    cout << "+---------+--------------+--------------+--------------+--------------+\n";
+
+    for (std::size_t threads = 1; ; threads = std::min(threads * 2, hardware)) {
+        // Pool of exactly this many workers
+        ThreadPool pool(threads);
+        // Same unsorted vector for fairness.
+        std::vector<int> process(vector);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        Sort::parallel_radix_sort(process.begin(), process.end(), pool);
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> radix = stop - start;
+
+        process = vector;
+        start = std::chrono::high_resolution_clock::now();
+        Sort::parallel_sample_sort(process.begin(), process.end(), pool);
+        stop = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> sample = stop - start;
+
+        if (threads == 1) {
+            singleRadix = radix.count();
+            singleSample = sample.count();
+        }
+        cout << BAR[1] << CW << threads << BAR << CW2 << radix.count();
+        cout << BAR << CW2 << singleRadix / radix.count();
+        cout << BAR << CW2 << sample.count() << BAR << CW2 << singleSample / sample.count();
+        cout << BAR << '\n';
+
+        if (threads == hardware) {
+            break;
+        }
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// Runs multiway merge sort on the same vector with a growing fan-in.
+/// @param [in] size The vector size to sort.
+/// @note Every pass reads and writes each element once, so the bytes moved
+/// per element are twice the element size per pass.
+/// ----------------------------------------------------------------------------
+void run_multiway_sweep(int size) {
+    std::vector<int> vector(size);
+    randFill(vector);
+
+    cout << std::setprecision(6) << std::showpoint << std::fixed;
+    cout << BAR[1] << CW << "Ways:" << BAR << CW2 << "Seconds:" << BAR << CW2 << "Passes:";
+    cout << BAR << CW2 << "Bytes/Elem:" << BAR << '\n';
+    cout << "+---------+--------------+--------------+--------------+\n";
+
+    for (std::size_t ways = 2; ways <= 32; ways *= 2) {
+        // Same unsorted vector for fairness.
+        std::vector<int> process(vector);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::size_t passes = Sort::multiway_merge_sort(process.begin(), process.end(), ways);
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = stop - start;
+
+        cout << BAR[1] << CW << ways << BAR << CW2 << elapsed.count() << BAR << CW2 << passes;
+        cout << BAR << CW2 << passes * 2 * sizeof(int) << BAR << '\n';
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// Runs recursive and tiled merge sort over growing vectors, reporting the
+/// time and the cache misses per element.
+/// @param [in] size The largest vector size to sort.
+/// @note Past the last level cache the recursive version's time per element
+/// climbs, the tiled version should stay flatter. Misses read "n/a" where
+/// hardware counters are unavailable.
+/// ----------------------------------------------------------------------------
+void run_cache_sweep(int size) {
+    // Algorithms compared, the current recursive version first
+    const sor_algorithms compared[2] = {{"MergeSort:", &mergeSort}, {"Tiled:", &tiledSort}};
+
+    cout << std::setprecision(3) << std::showpoint << std::fixed;
+    cout << BAR[1] << CW2 << "Size:";
+    for (const auto& run : compared) {
+        cout << BAR << CW2 << run.name << BAR << CW2 << "Misses/Elem:";
+    }
+    cout << BAR << '\n';
+    cout << "+--------------+--------------+--------------+--------------+--------------+\n";
+
+    for (int elements = 1 << 16; elements > 0 && elements <= size; elements *= 2) {
+        std::vector<int> vector(elements);
+        randFill(vector);
+
+        cout << BAR[1] << CW2 << elements;
+        for (const auto& run : compared) {
+            // Same unsorted vector for fairness.
+            std::vector<int> process(vector);
+            double seconds = 0;
+            long long misses = measure_misses(process, run.algorithm, seconds);
+
+            // Nanoseconds per element
+            cout << BAR << CW2 << seconds * 1e9 / elements << BAR << CW2;
+            if (misses < 0) {
+                cout << "n/a";
+            }
+            else {
+                cout << static_cast<double>(misses) / elements;
+            }
+        }
+        cout << BAR << '\n';
+
+        if (elements > size / 2) {
+            break;
+        }
+    }
+    cout << "(Sort columns in nanoseconds per element)\n";
+}
+
+/// ----------------------------------------------------------------------------
+/// Writes random keys to a file, sorts it externally and checks the result.
+/// @param [in] size The number of keys to write.
+/// @param [in] options Temp directory, memory budget and merge fan-in.
+/// @note Both files are written to the working directory and deleted after.
+/// ----------------------------------------------------------------------------
+void run_external_sort(int size, const ExternalSort::Options& options) {
+    const std::string input = "External_Input.bin";
+    const std::string output = "External_Sorted.bin";
+
+    if (!write_keys(input, size)) {
+        cout << "Failed to write " << input << ".\n";
+        std::remove(input.c_str());
+        return;
+    }
+
+    ExternalSort::Stats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+    bool status = ExternalSort::sort_file<int>(input, output, options, stats);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = stop - start;
+
+    status = status && check_keys(output, size);
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+
+    cout << std::setprecision(3) << std::showpoint << std::fixed;
+    cout << "Sorted:        " << (status ? "yes" : "no, I/O error or bad output") << '\n';
+    cout << "Seconds:       " << elapsed.count() << '\n';
+    cout << "MiB/s:         " << size * sizeof(int) / elapsed.count() / (1 << 20) << '\n';
+    cout << "Runs:          " << stats.runs << '\n';
+    cout << "Merge passes:  " << stats.passes << '\n';
+    cout << "MiB read:      " << stats.bytesRead / double(1 << 20) << '\n';
+    cout << "MiB written:   " << stats.bytesWritten / double(1 << 20) << '\n';
+    cout << "I/O backend:   " << AsyncFile::backend() << '\n';
+}
+
+/// ----------------------------------------------------------------------------
+/// Writes random keys to a file, sorts it in place through a memory mapping
+/// and checks the result.
+/// @param [in] size The number of keys to write.
+/// @note The file is written to the working directory and deleted after.
+/// ----------------------------------------------------------------------------
+void run_mapped_sort(int size) {
+    const std::string path = "Mapped_Keys.bin";
+
+    if (!MappedFile::supported()) {
+        cout << "Memory mapped files are not supported on this system.\n";
+        return;
+    }
+    if (!write_keys(path, size)) {
+        cout << "Failed to write " << path << ".\n";
+        std::remove(path.c_str());
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool status = ExternalSort::sort_mapped<int>(path);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = stop - start;
+
+    status = status && check_keys(path, size);
+    std::remove(path.c_str());
+
+    cout << std::setprecision(3) << std::showpoint << std::fixed;
+    cout << "Sorted:        " << (status ? "yes" : "no, mapping failed or bad output") << '\n';
+    cout << "Seconds:       " << elapsed.count() << '\n';
+    cout << "MiB/s:         " << size * sizeof(int) / elapsed.count() / (1 << 20) << '\n';
+}
+
+/// ----------------------------------------------------------------------------
+/// Writes random int keys to a binary file.
+/// @param [in] path The file to write.
+/// @param [in] size The number of keys to write.
+/// @returns true if every key was written.
+/// ----------------------------------------------------------------------------
+bool write_keys(const std::string& path, int size) {
+    std::vector<int> block(1 << 20);                // Keys written at a time
+    std::mt19937 generator;
+
+    std::ofstream unsorted(path, std::ios::binary);
+    for (int written = 0; written < size; written += static_cast<int>(block.size())) {
+        const int count = std::min(size - written, static_cast<int>(block.size()));
+        for (int index = 0; index < count; index++) {
+            block[index] = static_cast<int>(generator());
+        }
+        unsorted.write(reinterpret_cast<const char*>(block.data()), count * sizeof(int));
+    }
+    unsorted.close();
+
+    return !unsorted.fail();
+}
+
+/// ----------------------------------------------------------------------------
+/// Checks a binary file of int keys is sorted and complete.
+/// @param [in] path The file to check.
+/// @param [in] size The number of keys it must hold.
+/// @returns true if the file holds size keys in ascending order.
+/// ----------------------------------------------------------------------------
+bool check_keys(const std::string& path, int size) {
+    std::vector<int> block(1 << 20);                // Keys checked at a time
+    std::ifstream sorted(path, std::ios::binary);
+    long long checked = 0;
+    int previous = std::numeric_limits<int>::min();
+    bool status = sorted.is_open();
+
+    while (status && sorted) {
+        sorted.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(int));
+        const long long count = sorted.gcount() / static_cast<long long>(sizeof(int));
+        for (long long index = 0; index < count; index++) {
+            status = status && previous <= block[index];
+            previous = block[index];
+        }
+        checked += count;
+    }
+
+    return status && checked == size;
 }
 
 /// ----------------------------------------------------------------------------
@@ -339,6 +788,9 @@ bool print_benchmark(int start, int end) {
     std::ofstream file("Sorting_Results.txt");
 
     file << std::left << std::setprecision(6) << std::showpoint << std::fixed;
+    // Worker threads used by the parallel algorithms, a gnuplot comment
+    file << "# Threads: " << ThreadPool::instance().size() << '\n';
+    file << "# Kernel: " << Simd::kernel_name() << '\n';
     file << CW2 << "Size" << flush;
 
     // Print header of algorithm names
@@ -361,6 +813,9 @@ bool print_benchmark(int start, int end) {
         file << '\n';
     }
 
+    // Work stealing balance of the largest parallel quick sort run
+    file << "# ParQuick steals per worker: " << quickSteals << '\n';
+
     // Check if file had issues
     if(file.bad()) {
         fileStatus = false;
@@ -0,0 +1,405 @@
+/// @file: AsyncIO.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This file implements the pieces of the external sort's I/O
+/// pipeline: a bounded blocking queue handing buffers between stage threads,
+/// and a sequential file whose large transfers are split into requests kept
+/// in flight together. Built with SORT_IO_URING and liburing, the requests
+/// go through io_uring. Otherwise every transfer is one blocking stdio call
+/// on the calling stage thread, which overlaps it with the other stages.
+
+#ifndef ASYNCIO_H_
+#define ASYNCIO_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#ifdef SORT_IO_URING
+#include <cerrno>
+#include <thread>
+#include <fcntl.h>
+#include <liburing.h>
+#include <unistd.h>
+#endif
+
+/// ----------------------------------------------------------------------------
+///                            BoundedQueue Class
+/// ----------------------------------------------------------------------------
+template <class T>
+class BoundedQueue {
+public:
+	// Builds an empty queue holding at most capacity items
+	explicit BoundedQueue(std::size_t capacity);
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	// Adds an item, waiting while the queue is full, false once closed
+	bool push(T item);
+	// Takes the oldest item, waiting while the queue is empty, false once
+	// closed and drained
+	bool pop(T& item);
+	// Refuses further items and wakes every waiting thread
+	void close();
+
+private:
+	std::deque<T> items;                            ///< Queued items, oldest first
+	std::size_t capacity;                           ///< Most items queued at once
+	std::mutex mutex;                               ///< Guards items and closed
+	std::condition_variable notFull;                ///< Signals a taken item
+	std::condition_variable notEmpty;               ///< Signals an added item
+	bool closed;                                    ///< Set once no item will come
+};
+
+// ----------------------------------------------------------------------------
+// Builds an empty queue.
+// @param [in] capacity Most items queued at once, at least one.
+// ----------------------------------------------------------------------------
+template <class T>
+BoundedQueue<T>::BoundedQueue(std::size_t capacity)
+    : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+// ----------------------------------------------------------------------------
+// Adds an item behind the others.
+// @param [in] item The item, moved into the queue.
+// @note Blocks while the queue is full, which is what bounds the memory a
+// faster stage can run ahead with.
+// @returns false if the queue was closed, the item is then dropped.
+// ----------------------------------------------------------------------------
+template <class T>
+bool BoundedQueue<T>::push(T item) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+    }
+    notEmpty.notify_one();
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Takes the oldest item.
+// @param [out] item Receives the item.
+// @note Items queued before close are still handed out.
+// @returns false once the queue is closed and empty.
+// ----------------------------------------------------------------------------
+template <class T>
+bool BoundedQueue<T>::pop(T& item) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+    }
+    notFull.notify_one();
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Refuses further items and wakes every waiting thread.
+// ----------------------------------------------------------------------------
+template <class T>
+void BoundedQueue<T>::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    notFull.notify_all();
+    notEmpty.notify_all();
+}
+
+/// ----------------------------------------------------------------------------
+///                             AsyncFile Class
+/// ----------------------------------------------------------------------------
+class AsyncFile {
+public:
+	// Bytes moved by one request
+	static constexpr std::size_t REQUEST_BYTES = std::size_t(1) << 20;
+	// Requests kept in flight by one transfer
+	static constexpr unsigned QUEUE_DEPTH = 8;
+
+	AsyncFile();
+	// Closes the file if still open
+	~AsyncFile();
+
+	AsyncFile(const AsyncFile&) = delete;
+	AsyncFile& operator=(const AsyncFile&) = delete;
+
+	// Opens a file for sequential reading, or creates one for writing
+	bool open(const std::string& path, bool write);
+	// Reads up to bytes, returns the bytes read, short at the end or on an error
+	std::size_t read(void* data, std::size_t bytes);
+	// Writes bytes, returns false on an error
+	bool write(const void* data, std::size_t bytes);
+	// Closes the file, returns false if any transfer or the close failed
+	bool close();
+	// Whether a transfer failed
+	bool failed() const;
+	// Name of the I/O backend compiled in
+	static const char* backend();
+
+private:
+#ifdef SORT_IO_URING
+	// Moves bytes at the file offset through the stage thread's ring
+	std::size_t transfer(void* data, std::size_t bytes, bool write);
+
+	int descriptor;                                 ///< Open file, -1 if none
+	std::uint64_t offset;                           ///< Position of the next transfer
+#else
+	std::FILE* file;                                ///< Open file, null if none
+#endif
+	bool error;                                     ///< Set by a failed transfer
+};
+
+// ----------------------------------------------------------------------------
+// Builds a closed file.
+// ----------------------------------------------------------------------------
+#ifdef SORT_IO_URING
+inline AsyncFile::AsyncFile() : descriptor(-1), offset(0), error(false) {}
+#else
+inline AsyncFile::AsyncFile() : file(nullptr), error(false) {}
+#endif
+
+// ----------------------------------------------------------------------------
+// Closes the file if still open, ignoring the outcome.
+// ----------------------------------------------------------------------------
+inline AsyncFile::~AsyncFile() {
+    close();
+}
+
+// ----------------------------------------------------------------------------
+// Opens a file.
+// @param [in] path Path of the file.
+// @param [in] write Whether to create or truncate it for writing rather
+// than read it.
+// @returns true if the file is open.
+// ----------------------------------------------------------------------------
+inline bool AsyncFile::open(const std::string& path, bool write) {
+    close();
+    error = false;
+#ifdef SORT_IO_URING
+    descriptor = write ? ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)
+                       : ::open(path.c_str(), O_RDONLY);
+    offset = 0;
+    return descriptor >= 0;
+#else
+    file = std::fopen(path.c_str(), write ? "wb" : "rb");
+    return file != nullptr;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Reads the next bytes of the file.
+// @param [out] data Receives the bytes.
+// @param [in] bytes Bytes wanted.
+// @returns the bytes read, fewer only at the end of the file or on an error.
+// ----------------------------------------------------------------------------
+inline std::size_t AsyncFile::read(void* data, std::size_t bytes) {
+#ifdef SORT_IO_URING
+    return transfer(data, bytes, false);
+#else
+    const std::size_t count = std::fread(data, 1, bytes, file);
+    error = error || std::ferror(file) != 0;
+    return count;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Appends bytes to the file.
+// @param [in] data The bytes.
+// @param [in] bytes Bytes to write.
+// @returns true if every byte was written.
+// ----------------------------------------------------------------------------
+inline bool AsyncFile::write(const void* data, std::size_t bytes) {
+#ifdef SORT_IO_URING
+    const bool written = transfer(const_cast<void*>(data), bytes, true) == bytes;
+#else
+    const bool written = std::fwrite(data, 1, bytes, file) == bytes;
+#endif
+    error = error || !written;
+    return written;
+}
+
+// ----------------------------------------------------------------------------
+// Closes the file.
+// @returns true if the file was open and every transfer and the close
+// succeeded.
+// ----------------------------------------------------------------------------
+inline bool AsyncFile::close() {
+    bool closed = false;
+#ifdef SORT_IO_URING
+    if (descriptor >= 0) {
+        closed = ::close(descriptor) == 0;
+        descriptor = -1;
+    }
+#else
+    if (file != nullptr) {
+        closed = std::fclose(file) == 0;
+        file = nullptr;
+    }
+#endif
+    return closed && !error;
+}
+
+// ----------------------------------------------------------------------------
+// Whether a transfer failed since the file was opened.
+// ----------------------------------------------------------------------------
+inline bool AsyncFile::failed() const {
+    return error;
+}
+
+// ----------------------------------------------------------------------------
+// Name of the I/O backend compiled in.
+// @returns "io_uring" or "threads".
+// ----------------------------------------------------------------------------
+inline const char* AsyncFile::backend() {
+#ifdef SORT_IO_URING
+    return "io_uring";
+#else
+    return "threads";
+#endif
+}
+
+#ifdef SORT_IO_URING
+// ----------------------------------------------------------------------------
+// Moves bytes at the current offset through io_uring.
+// @param [in,out] data The bytes to write, or the buffer receiving them.
+// @param [in] bytes Bytes to move.
+// @param [in] write Whether to write rather than read.
+// @note Every stage thread owns a ring, so no ring is shared. A transfer is
+// cut into requests of REQUEST_BYTES, up to QUEUE_DEPTH of them submitted
+// together, which keeps the device queue full where one blocking call
+// keeps one request in flight. Completions arrive in any order, each tagged
+// with its request's start. The bytes up to the first short request are
+// done, and the next batch starts there, so a short request with bytes
+// moved is resubmitted for the rest. Only a failed request, or a request
+// moving no bytes at the end of the bytes done, the end of the file, ends
+// the transfer. Every submitted request is reaped before returning, since the kernel
+// owns its buffer until it completes. A failed submit leaves prepared
+// entries in the ring, so the ring is torn down and set up again on next
+// use rather than submit them later for a buffer that is gone.
+// @returns the bytes moved, fewer only at the end of the file or on an error.
+// ----------------------------------------------------------------------------
+inline std::size_t AsyncFile::transfer(void* data, std::size_t bytes, bool write) {
+    // Ring of the calling thread, set up on first use
+    struct ring_holder {
+        io_uring ring;
+        bool ready;
+
+        ring_holder() : ready(false) {}
+        ~ring_holder() {
+            stop();
+        }
+        bool start() {
+            ready = ready || io_uring_queue_init(QUEUE_DEPTH, &ring, 0) == 0;
+            return ready;
+        }
+        void stop() {
+            if (ready) {
+                io_uring_queue_exit(&ring);
+            }
+            ready = false;
+        }
+    };
+    static thread_local ring_holder holder;
+    const std::size_t requestBytes = REQUEST_BYTES;  // Copied, std::min would odr-use it
+    char* bytesData = static_cast<char*>(data);
+    std::size_t done = 0;                           // Bytes moved by every request so far
+
+    if (!holder.start()) {
+        error = true;
+        return 0;
+    }
+
+    while (done < bytes) {
+        // Queue a batch of requests.
+        std::size_t submitted = done;               // Bytes asked for so far
+        unsigned queued = 0;
+        while (queued < QUEUE_DEPTH && submitted < bytes) {
+            io_uring_sqe* entry = io_uring_get_sqe(&holder.ring);
+            if (entry == nullptr) {
+                break;
+            }
+            const std::size_t size = std::min(requestBytes, bytes - submitted);
+            if (write) {
+                io_uring_prep_write(entry, descriptor, bytesData + submitted,
+                                    static_cast<unsigned>(size), offset + submitted);
+            }
+            else {
+                io_uring_prep_read(entry, descriptor, bytesData + submitted,
+                                   static_cast<unsigned>(size), offset + submitted);
+            }
+            io_uring_sqe_set_data(entry, reinterpret_cast<void*>(submitted));
+            submitted += size;
+            queued++;
+        }
+
+        // Submit the batch, a short submit leaves the rest queued for the next.
+        unsigned taken = 0;
+        while (taken < queued) {
+            const int count = io_uring_submit(&holder.ring);
+            if (count <= 0 && count != -EINTR) {
+                break;
+            }
+            taken += count > 0 ? static_cast<unsigned>(count) : 0;
+        }
+        // Only the leading requests were handed to the kernel.
+        std::size_t end = std::min(submitted, done + taken * requestBytes);
+
+        // Reap every submitted request, the bytes done end at the first short one.
+        bool stop = taken < queued;                 // Set by an error
+        std::size_t eof = std::numeric_limits<std::size_t>::max();  // First request moving no bytes
+        for (unsigned request = 0; request < taken; request++) {
+            io_uring_cqe* completion = nullptr;
+            // A failed wait leaves the request with the kernel, which still
+            // posts its completion to the shared ring, so poll for it.
+            while (io_uring_wait_cqe(&holder.ring, &completion) < 0
+                   && io_uring_peek_cqe(&holder.ring, &completion) < 0) {
+                std::this_thread::yield();
+            }
+            const std::size_t start =
+                reinterpret_cast<std::size_t>(io_uring_cqe_get_data(completion));
+            const std::size_t size = std::min(requestBytes, bytes - start);
+            if (completion->res < 0) {
+                error = true;
+                stop = true;
+                end = std::min(end, start);
+            }
+            else if (completion->res == 0) {
+                eof = std::min(eof, start);
+                end = std::min(end, start);
+            }
+            else if (static_cast<std::size_t>(completion->res) < size) {
+                end = std::min(end, start + static_cast<std::size_t>(completion->res));
+            }
+            io_uring_cqe_seen(&holder.ring, completion);
+        }
+        if (taken < queued) {
+            error = true;
+            holder.stop();
+        }
+        done = end;
+        if (stop || end == eof) {
+            break;
+        }
+    }
+    offset += done;
+    return done;
+}
+#endif
+
+#endif  /* ASYNCIO_H_ */
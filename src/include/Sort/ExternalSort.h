@@ -0,0 +1,533 @@
+/// @file: ExternalSort.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements an external merge sort for binary files of
+/// fixed size keys larger than memory. The input is read in memory sized
+/// chunks, each is sorted by the in-memory engine and spilled as a sorted
+/// run, and the runs are k-way merged with large sequential reads and
+/// writes until one sorted file is left. Both phases run as pipelines of
+/// stage threads joined by bounded queues, so reading, sorting or merging,
+/// and writing overlap instead of taking turns. Files of integral keys can
+/// also be sorted in place through a memory mapping, without a second copy.
+
+#ifndef EXTERNALSORT_H_
+#define EXTERNALSORT_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "MappedFile.h"
+#include "Sort.h"
+#include "ThreadPool.h"
+
+/// ----------------------------------------------------------------------------
+///                            ExternalSort Class
+/// ----------------------------------------------------------------------------
+class ExternalSort {
+public:
+	// Settings of an external sort
+	struct Options {
+		std::string tempDir = ".";                      ///< Directory receiving the runs
+		std::size_t memoryBytes = std::size_t(256) << 20;   ///< Memory the sort may use
+		std::size_t fanIn = 16;                         ///< Runs merged at once
+	};
+
+	// What an external sort did
+	struct Stats {
+		std::size_t runs = 0;                           ///< Sorted runs spilled
+		std::size_t passes = 0;                         ///< Merge passes over the data
+		std::uint64_t bytesRead = 0;                    ///< Bytes read, runs included
+		std::uint64_t bytesWritten = 0;                 ///< Bytes written, runs included
+	};
+
+	// Sorts a binary file of T into another file, returns false on an I/O error or a partial key
+	template <class T, class Compare = std::less<>>
+	static bool sort_file(const std::string& input, const std::string& output,
+	                      const Options& options, Stats& stats, Compare comp = Compare());
+	// Sorts a binary file of integral T in place through a memory mapping on
+	// the shared pool, returns false on an I/O error or if the file cannot be mapped
+	template <class T>
+	static bool sort_mapped(const std::string& path);
+	// Sorts a binary file of integral T in place through a memory mapping,
+	// returns false on an I/O error or if the file cannot be mapped
+	template <class T>
+	static bool sort_mapped(const std::string& path, ThreadPool& pool);
+
+private:
+	// Stride of the pass reading a mapped file in, the smallest common page
+	static constexpr std::size_t MAPPED_PAGE_BYTES = 4096;
+
+	// Path of a run file, unique to one sort
+	static std::string run_path(const Options& options, const std::string& token,
+	                            std::size_t pass, std::size_t index);
+	// Reads the input in chunks and spills each one as a sorted run
+	template <class T, class Compare>
+	static bool spill_runs(const std::string& input, const std::string& output,
+	                       const Options& options, const std::string& token,
+	                       std::vector<std::string>& runs, Stats& stats, Compare& comp);
+	// Merges sorted run files into one sorted file
+	template <class T, class Compare>
+	static bool merge_runs(const std::vector<std::string>& runs, const std::string& output,
+	                       std::size_t bufferElements, Stats& stats, Compare& comp);
+	// Deletes run files
+	static void remove_runs(const std::vector<std::string>& runs);
+};
+
+// ----------------------------------------------------------------------------
+// Sorts a binary file of fixed size keys larger than memory.
+// @param [in] input Path of the file to sort, a packed array of T.
+// @param [in] output Path receiving the sorted file, not the input's.
+// @param [in] options Temp directory, memory budget and merge fan-in.
+// @param [out] stats Receives the runs, passes and bytes moved.
+// @param [in] comp The comparator applied to the keys.
+// @note Chunks are sized so the three chunks in the pipeline and the
+// sample sort's scratch, a chunk long buffer and a 16-bit bucket per key,
+// fit the budget. Merging splits it among two read
+// buffers per run and two output buffers as large as all of them.
+// When more runs exist than the fan-in, groups of them are merged into
+// longer runs first, each such pass reading and writing the data once.
+// The sort is not stable. Run files are deleted whether or not it succeeds.
+// An input whose size is not a multiple of sizeof(T) fails the sort, and a
+// failed sort removes the output it started.
+// @returns true if the output was written completely.
+// ----------------------------------------------------------------------------
+template <class T, class Compare>
+bool ExternalSort::sort_file(const std::string& input, const std::string& output,
+                             const Options& options, Stats& stats, Compare comp) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "sort_file reads and writes T as raw bytes");
+    const std::size_t fanIn = options.fanIn < 2 ? 2 : options.fanIn;
+    const std::size_t bufferElements =
+        std::max<std::size_t>(1, options.memoryBytes / (4 * fanIn * sizeof(T)));
+    // Sets this sort's run files apart from any other sort's
+    const std::string token = std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    std::vector<std::string> runs;
+
+    stats = Stats();
+
+    // Read the input and spill the sorted runs.
+    bool status = spill_runs<T>(input, output, options, token, runs, stats, comp);
+
+    // Merge groups of runs until one merge can finish the sort.
+    for (std::size_t pass = 1; status && runs.size() > fanIn; pass++) {
+        std::vector<std::string> merged;
+        for (std::size_t start = 0; status && start < runs.size(); start += fanIn) {
+            const std::size_t end = std::min(start + fanIn, runs.size());
+            std::vector<std::string> group(runs.begin() + start, runs.begin() + end);
+
+            merged.push_back(run_path(options, token, pass, merged.size()));
+            status = merge_runs<T>(group, merged.back(), bufferElements, stats, comp);
+            remove_runs(group);
+        }
+        // Groups not reached after a failure
+        if (!status) {
+            remove_runs(std::vector<std::string>(
+                runs.begin() + std::min(merged.size() * fanIn, runs.size()), runs.end()));
+        }
+        runs.swap(merged);
+        stats.passes++;
+    }
+
+    // A single chunk was already written to the output.
+    if (status && !runs.empty()) {
+        status = merge_runs<T>(runs, output, bufferElements, stats, comp);
+        stats.passes++;
+    }
+    remove_runs(runs);
+
+    return status;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a binary file of integral keys in place on the shared pool.
+// @param [in] path Path of the file, a packed array of T.
+// @note Must not be called from a task of the shared pool, which would wait
+// on itself.
+// @returns true if the file was mapped, sorted and flushed.
+// ----------------------------------------------------------------------------
+template <class T>
+bool ExternalSort::sort_mapped(const std::string& path) {
+    return sort_mapped<T>(path, ThreadPool::instance());
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a binary file of integral keys in place through a memory mapping.
+// @param [in] path Path of the file, a packed array of T.
+// @param [in] pool The pool whose workers sort the buckets, not one whose
+// task is calling.
+// @note The keys are never read into a buffer nor written back from one.
+// Sorting happens in the shared mapping, so the page cache is the only copy
+// and other readers of the file see the sorted keys. The sort runs in three
+// phases, each with its own madvise hint:
+//  1. Sequential: one byte of every page is touched front to back, reading
+//     the file in at device bandwidth.
+//  2. Random: msd_radix_partition swaps every key into its bucket by the
+//     highest key byte, hopping between buckets all over the file.
+//  3. Local: the buckets are sorted on their own across the thread pool,
+//     each asked for ahead of its sort and started on the digit below the
+//     one the partition split on.
+// The changes are flushed with msync before the mapping is closed. Only
+// POSIX systems take the hints. On systems without mappings it returns
+// false, and sort_file works instead.
+// @returns true if the file was mapped, sorted and flushed.
+// ----------------------------------------------------------------------------
+template <class T>
+bool ExternalSort::sort_mapped(const std::string& path, ThreadPool& pool) {
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                  "sort_mapped needs integral keys");
+    MappedFile file;
+
+    if (!file.open(path) || file.size() % sizeof(T) != 0) {
+        return false;
+    }
+    T* keys = static_cast<T*>(file.data());
+    const std::size_t size = file.size() / sizeof(T);
+
+    // Read the file in front to back.
+    file.advise(MappedFile::Access::sequential, 0, file.size());
+    const unsigned char* bytes = static_cast<const unsigned char*>(file.data());
+    volatile unsigned char sink = 0;
+    for (std::size_t offset = 0; offset < file.size(); offset += MAPPED_PAGE_BYTES) {
+        sink = bytes[offset];
+    }
+    (void)sink;
+
+    // Swap the keys into buckets by their highest differing byte.
+    file.advise(MappedFile::Access::random, 0, file.size());
+    std::vector<std::size_t> bounds;
+    const int shift = Sort::msd_radix_partition(keys, keys + size, bounds);
+
+    // Sort every bucket on its own from the next lower byte, the lowest
+    // byte leaves only equal keys in a bucket.
+    pool.run(bounds.size() - 1, [&](std::size_t bucket) {
+        const std::size_t begin = bounds[bucket];
+        const std::size_t end = bounds[bucket + 1];
+        if (end - begin > 1 && shift > 0) {
+            file.advise(MappedFile::Access::willneed, begin * sizeof(T), (end - begin) * sizeof(T));
+            Sort::msd_radix_sort(keys + begin, keys + end, shift);
+        }
+    });
+
+    const bool synced = file.sync();
+    return file.close() && synced;
+}
+
+// ----------------------------------------------------------------------------
+// Path of a run file.
+// @param [in] options Settings holding the temp directory.
+// @param [in] token Text unique to this sort.
+// @param [in] pass Merge pass that wrote the run, 0 for spilled chunks.
+// @param [in] index Position of the run within its pass.
+// @returns the path.
+// ----------------------------------------------------------------------------
+inline std::string ExternalSort::run_path(const Options& options, const std::string& token,
+                                          std::size_t pass, std::size_t index) {
+    return options.tempDir + "/sort_run_" + token + "_" + std::to_string(pass) + "_"
+           + std::to_string(index) + ".bin";
+}
+
+// ----------------------------------------------------------------------------
+// Reads the input in memory sized chunks, sorts and spills each one.
+// @param [in] input Path of the file to sort.
+// @param [in] output Path of the final output.
+// @param [in] options Settings holding the temp directory and the budget.
+// @param [in] token Text unique to this sort.
+// @param [out] runs Receives the paths of the spilled runs.
+// @param [in,out] stats Counts the runs and bytes moved.
+// @param [in] comp The comparator applied to the keys.
+// @note A reader thread fills chunks and a writer thread spills them, while
+// the calling thread sorts. Three chunks circulate through bounded queues,
+// so chunk N + 1 is read while chunk N is sorted and chunk N - 1 written.
+// Chunks are allocated on first use, small inputs never take three. Input
+// that fits one chunk is sorted straight into the output, so it leaves no
+// runs to merge. Trailing bytes short of a key fail the read.
+// @returns true if every chunk was read and written.
+// ----------------------------------------------------------------------------
+template <class T, class Compare>
+bool ExternalSort::spill_runs(const std::string& input, const std::string& output,
+                              const Options& options, const std::string& token,
+                              std::vector<std::string>& runs, Stats& stats, Compare& comp) {
+    // One chunk of keys on its way through the stages
+    struct chunk {
+        std::vector<T> keys;        // Room for a chunk
+        std::size_t count;          // Keys read into it
+        std::string path;           // File it is spilled to
+    };
+    constexpr std::size_t CHUNKS = 3;
+    // Three chunks in the pipeline, and the sort's scratch buffer as long as a
+    // chunk plus its 16-bit bucket per key, share the budget.
+    const std::size_t chunkElements = std::max<std::size_t>(
+        1, options.memoryBytes / (4 * sizeof(T) + sizeof(std::uint16_t)));
+    BoundedQueue<chunk> spare(CHUNKS);              // Chunks written, ready for reading
+    BoundedQueue<chunk> filled(1);                  // Chunks read, waiting for the sort
+    BoundedQueue<chunk> sorted(1);                  // Chunks sorted, waiting for the writer
+    std::atomic<bool> failed(false);                // Set by any stage on an error
+    std::uint64_t written = 0;                      // Bytes the writer wrote
+    AsyncFile file;
+
+    if (!file.open(input, false)) {
+        return false;
+    }
+
+    std::thread reader([&]() {
+        std::size_t created = 0;
+        while (!failed) {
+            chunk next;
+            if (created < CHUNKS) {
+                next.keys.resize(chunkElements);
+                created++;
+            }
+            else if (!spare.pop(next)) {
+                break;
+            }
+            const std::size_t got = file.read(next.keys.data(), chunkElements * sizeof(T));
+            next.count = got / sizeof(T);
+            // A partial key at the end means the input is not an array of T.
+            failed = failed || file.failed() || got % sizeof(T) != 0;
+            const bool last = next.count < chunkElements;
+            filled.push(std::move(next));
+            if (last) {
+                break;
+            }
+        }
+        filled.close();
+    });
+
+    std::thread writer([&]() {
+        chunk done;
+        while (sorted.pop(done)) {
+            AsyncFile run;
+            const bool opened = !failed && run.open(done.path, true);
+            if (opened && run.write(done.keys.data(), done.count * sizeof(T)) && run.close()) {
+                written += done.count * sizeof(T);
+            }
+            else {
+                failed = true;
+                // Leave no partial run or output behind.
+                if (opened) {
+                    run.close();
+                    std::remove(done.path.c_str());
+                }
+            }
+            spare.push(std::move(done));
+        }
+    });
+
+    chunk current;
+    while (filled.pop(current)) {
+        stats.bytesRead += current.count * sizeof(T);
+        // Nothing past a full last chunk, or a stage already failed
+        if (failed || (current.count == 0 && !runs.empty())) {
+            spare.push(std::move(current));
+            continue;
+        }
+
+        Sort::parallel_sample_sort(current.keys.begin(), current.keys.begin() + current.count, comp);
+
+        // The whole input in one chunk goes straight to the output.
+        const bool whole = runs.empty() && current.count < chunkElements;
+        current.path = whole ? output : run_path(options, token, 0, runs.size());
+        if (!whole) {
+            runs.push_back(current.path);
+            stats.runs++;
+        }
+        sorted.push(std::move(current));
+    }
+    sorted.close();
+    writer.join();
+    reader.join();
+    stats.bytesWritten += written;
+
+    return file.close() && !failed;
+}
+
+// ----------------------------------------------------------------------------
+// Merges sorted run files into one sorted file.
+// @param [in] runs Paths of the sorted runs.
+// @param [in] output Path receiving the merged file.
+// @param [in] bufferElements Elements read from a run at a time.
+// @param [in,out] stats Counts the bytes moved.
+// @param [in] comp The comparator applied to the keys.
+// @note Every round takes the next buffer of the runs whose buffer is used
+// up. The smallest last buffered key of the runs with data left on disk
+// bounds the round, since nothing unread sorts before it. Every buffered
+// key up to it is merged by Sort::kway_merge into one output buffer. The
+// run holding the bound empties its buffer, so each round reads one more.
+// A reader thread keeps the next buffer of every run in flight, and a
+// writer thread writes one output buffer while the next is merged, so the
+// merge waits on the disk only when the disk is the slower side. A failed
+// merge removes its output.
+// @returns true if every run was read and the output written.
+// ----------------------------------------------------------------------------
+template <class T, class Compare>
+bool ExternalSort::merge_runs(const std::vector<std::string>& runs, const std::string& output,
+                              std::size_t bufferElements, Stats& stats, Compare& comp) {
+    // Keys read from a run, or merged for the output
+    struct block {
+        std::vector<T> keys;        // Room for the keys
+        std::size_t count;          // Keys held
+    };
+    // One open run and its buffers
+    struct source {
+        AsyncFile file;             // Run being read
+        BoundedQueue<block> ready;  // Buffers read ahead, in file order
+        block current;              // Buffer being merged
+        std::size_t head;           // Next unmerged key of it
+        bool more;                  // Whether the file may hold more keys
+
+        source() : ready(2), current(), head(0), more(true) {}
+    };
+    constexpr std::size_t BLOCKS = 2;
+    std::vector<std::unique_ptr<source>> sources;
+    BoundedQueue<std::pair<std::size_t, block>> requests(runs.size() + 1);  // Buffers to read, by run
+    BoundedQueue<block> spare(BLOCKS);              // Output buffers written
+    BoundedQueue<block> pending(1);                 // Output buffers waiting for the writer
+    std::atomic<bool> failed(false);                // Set by any stage on an error
+    std::uint64_t written = 0;                      // Bytes the writer wrote
+    std::vector<Span<const T>> spans;
+    std::vector<std::size_t> cuts;
+    AsyncFile out;
+
+    const bool opened = out.open(output, true);
+    bool status = opened;
+    for (std::size_t run = 0; status && run < runs.size(); run++) {
+        sources.emplace_back(new source());
+        status = sources.back()->file.open(runs[run], false);
+    }
+    if (!status) {
+        if (opened) {
+            out.close();
+            std::remove(output.c_str());
+        }
+        return false;
+    }
+
+    std::thread reader([&]() {
+        std::pair<std::size_t, block> request;
+        while (requests.pop(request)) {
+            source& run = *sources[request.first];
+            block& next = request.second;
+            next.count = failed ? 0
+                                : run.file.read(next.keys.data(), next.keys.size() * sizeof(T)) / sizeof(T);
+            failed = failed || run.file.failed();
+            run.ready.push(std::move(next));
+        }
+    });
+
+    std::thread writer([&]() {
+        block done;
+        while (pending.pop(done)) {
+            if (!failed && out.write(done.keys.data(), done.count * sizeof(T))) {
+                written += done.count * sizeof(T);
+            }
+            else {
+                failed = true;
+            }
+            spare.push(std::move(done));
+        }
+    });
+
+    // Every run starts with an empty buffer and its first read in flight.
+    for (std::size_t run = 0; run < sources.size(); run++) {
+        sources[run]->current = block{std::vector<T>(bufferElements), 0};
+        requests.push({run, block{std::vector<T>(bufferElements), 0}});
+    }
+
+    std::size_t created = 0;                        // Output buffers allocated
+    while (!failed) {
+        // Swap used up buffers for the ones read ahead, reading the next.
+        for (std::size_t run = 0; run < sources.size(); run++) {
+            source& input = *sources[run];
+            if (input.head == input.current.count && input.more) {
+                block next;
+                input.ready.pop(next);
+                stats.bytesRead += next.count * sizeof(T);
+                input.more = next.count == next.keys.size();
+                if (input.more) {
+                    requests.push({run, std::move(input.current)});
+                }
+                input.current = std::move(next);
+                input.head = 0;
+            }
+        }
+
+        // Smallest last key of the runs with keys left on disk
+        const T* bound = nullptr;
+        for (const auto& input : sources) {
+            const T* last = input->current.keys.data() + input->current.count - 1;
+            if (input->more && (bound == nullptr || comp(*last, *bound))) {
+                bound = last;
+            }
+        }
+
+        // Every buffered key up to the bound
+        std::size_t total = 0;
+        spans.clear();
+        cuts.clear();
+        for (const auto& input : sources) {
+            const T* first = input->current.keys.data() + input->head;
+            const T* last = input->current.keys.data() + input->current.count;
+            const T* cut = bound == nullptr ? last : std::upper_bound(first, last, *bound, comp);
+            spans.emplace_back(first, cut);
+            cuts.push_back(static_cast<std::size_t>(cut - input->current.keys.data()));
+            total += static_cast<std::size_t>(cut - first);
+        }
+        if (total == 0) {
+            break;
+        }
+
+        block merged;
+        if (created < BLOCKS) {
+            created++;
+        }
+        else {
+            spare.pop(merged);
+        }
+        if (merged.keys.size() < total) {
+            merged.keys.resize(total);
+        }
+        merged.count = total;
+        Sort::kway_merge(spans, merged.keys.data(), comp);
+        for (std::size_t run = 0; run < sources.size(); run++) {
+            sources[run]->head = cuts[run];
+        }
+        pending.push(std::move(merged));
+    }
+    requests.close();
+    pending.close();
+    reader.join();
+    writer.join();
+    stats.bytesWritten += written;
+
+    // Leave no partial output behind.
+    status = out.close() && !failed;
+    if (!status) {
+        std::remove(output.c_str());
+    }
+    return status;
+}
+
+// ----------------------------------------------------------------------------
+// Deletes run files, ignoring ones already gone.
+// @param [in] runs Paths of the runs.
+// ----------------------------------------------------------------------------
+inline void ExternalSort::remove_runs(const std::vector<std::string>& runs) {
+    for (const auto& run : runs) {
+        std::remove(run.c_str());
+    }
+}
+
+#endif  /* EXTERNALSORT_H_ */
@@ -0,0 +1,187 @@
+/// @file: LoserTree.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements a tournament tree of losers, which merges k
+/// sorted runs at once with log2(k) comparisons per element. Every internal
+/// node keeps the loser of the game played there, so replacing the winner
+/// only replays the games on its own path to the root.
+
+#ifndef LOSERTREE_H_
+#define LOSERTREE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/// ----------------------------------------------------------------------------
+///                             LoserTree Class
+/// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+class LoserTree {
+public:
+	// Builds the tree over sorted runs given as first and last iterators
+	LoserTree(const std::vector<std::pair<InputIt, InputIt>>& runs, Less& less);
+
+	// Whether every run is used up
+	bool empty() const;
+	// Smallest remaining element, from the earliest run on ties
+	typename std::iterator_traits<InputIt>::reference top() const;
+	// Drops the smallest element and replays the games of its run
+	void pop();
+	// Moves every remaining element to the output in order
+	template <class OutputIt>
+	OutputIt merge(OutputIt out);
+
+private:
+	// Whether the head of one run goes before the head of another
+	bool beats(std::size_t run, std::size_t other) const;
+	// Plays every game again over the runs left
+	void rebuild();
+	// Plays the games below a node and returns their winner
+	std::size_t build(std::size_t node);
+
+	std::vector<InputIt> heads;         ///< Next element of each run
+	std::vector<InputIt> ends;          ///< One past the end of each run
+	std::vector<std::size_t> losers;    ///< Loser of each game, the winner at 0
+	Less& less;                         ///< Projected comparator
+};
+
+// ----------------------------------------------------------------------------
+// Builds the tree and plays the first round.
+// @param [in] runs First and last iterator of every sorted run.
+// @param [in] less The projected comparator.
+// @note Run i is leaf k + i of an implicit binary tree whose internal nodes
+// are 1 to k - 1, so k needs not be a power of two. Empty runs are left
+// out, and a run leaves the tree once used up, so no game has to check for
+// used up runs.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+LoserTree<InputIt, Less>::LoserTree(const std::vector<std::pair<InputIt, InputIt>>& runs,
+                                    Less& less)
+    : less(less) {
+    for (const auto& run : runs) {
+        if (run.first != run.second) {
+            heads.push_back(run.first);
+            ends.push_back(run.second);
+        }
+    }
+    rebuild();
+}
+
+// ----------------------------------------------------------------------------
+// Whether every run is used up.
+// @returns true once the tree holds no element.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+bool LoserTree<InputIt, Less>::empty() const {
+    return heads.empty();
+}
+
+// ----------------------------------------------------------------------------
+// Smallest remaining element.
+// @returns the head of the winning run, the tree must not be empty.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+typename std::iterator_traits<InputIt>::reference LoserTree<InputIt, Less>::top() const {
+    return *heads[losers[0]];
+}
+
+// ----------------------------------------------------------------------------
+// Drops the smallest element and replays the games on its run's path.
+// @note The winner and its head are carried up in registers. It swaps with
+// the loser kept at a node only when that loser beats it, which is random
+// on random data, so the swap is selected rather than branched on. The
+// earlier run wins ties, asked as whether the later one goes first with
+// the answer flipped.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+void LoserTree<InputIt, Less>::pop() {
+    const std::size_t runs = heads.size();         // Leaves of the tree
+    std::size_t winner = losers[0];                // Winner carried upwards
+    InputIt winnerHead = ++heads[winner];          // Its head
+
+    // A used up run leaves, the rest play again
+    if (winnerHead == ends[winner]) {
+        heads.erase(heads.begin() + static_cast<std::ptrdiff_t>(winner));
+        ends.erase(ends.begin() + static_cast<std::ptrdiff_t>(winner));
+        rebuild();
+        return;
+    }
+
+    for (std::size_t node = (winner + runs) / 2; node > 0; node /= 2) {
+        const std::size_t loser = losers[node];
+        const InputIt players[2] = { heads[loser], winnerHead };
+        const bool earlier = loser < winner;
+        const bool swap = less(*players[earlier], *players[!earlier]) != earlier;
+        const std::size_t mask = (loser ^ winner) & (0 - static_cast<std::size_t>(swap));
+
+        losers[node] = loser ^ mask;
+        winner ^= mask;
+        winnerHead = players[!swap];
+    }
+    losers[0] = winner;
+}
+
+// ----------------------------------------------------------------------------
+// Moves every remaining element to the output in order.
+// @param [out] out The beginning of the destination.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+template <class OutputIt>
+OutputIt LoserTree<InputIt, Less>::merge(OutputIt out) {
+    while (!empty()) {
+        *out = std::move(top());
+        ++out;
+        pop();
+    }
+    return out;
+}
+
+// ----------------------------------------------------------------------------
+// Plays one game between the heads of two runs.
+// @param [in] run The run asking to win.
+// @param [in] other The run it plays against.
+// @note Equal heads go to the earlier run, which keeps the merge stable.
+// @returns true if run wins.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+bool LoserTree<InputIt, Less>::beats(std::size_t run, std::size_t other) const {
+    return run < other ? !less(*heads[other], *heads[run]) : less(*heads[run], *heads[other]);
+}
+
+// ----------------------------------------------------------------------------
+// Plays every game again, after the set of runs changed.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+void LoserTree<InputIt, Less>::rebuild() {
+    losers.assign(heads.size() > 1 ? heads.size() : 1, 0);
+    if (heads.size() > 1) {
+        losers[0] = build(1);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Plays the games below a node, storing each loser at its node.
+// @param [in] node The node, internal nodes are 1 to k - 1.
+// @returns the run winning every game below the node.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+std::size_t LoserTree<InputIt, Less>::build(std::size_t node) {
+    const std::size_t runs = heads.size();         // Leaves of the tree
+
+    if (node >= runs) {
+        return node - runs;
+    }
+    const std::size_t left = build(2 * node);
+    const std::size_t right = build(2 * node + 1);
+    if (beats(left, right)) {
+        losers[node] = right;
+        return left;
+    }
+    losers[node] = left;
+    return right;
+}
+
+#endif  /* LOSERTREE_H_ */
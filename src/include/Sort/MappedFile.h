@@ -0,0 +1,260 @@
+/// @file: MappedFile.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class maps a whole file into memory for reading and writing,
+/// so a file of keys can be sorted in place through the mapping. Changes go
+/// to the page cache, shared with every other reader of the file, and are
+/// flushed by sync. POSIX systems use mmap and madvise, Windows uses file
+/// mappings without access hints, and other systems cannot map.
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// ----------------------------------------------------------------------------
+///                             MappedFile Class
+/// ----------------------------------------------------------------------------
+class MappedFile {
+public:
+	// How a range of the mapping is about to be used
+	enum class Access {
+		normal,         ///< No particular order
+		sequential,     ///< Front to back once, read ahead aggressively
+		random,         ///< No order, read only the pages touched
+		willneed        ///< Soon, start reading it in now
+	};
+
+	MappedFile();
+	// Unmaps and closes the file if still open, without flushing it
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps a whole existing file for reading and writing
+	bool open(const std::string& path);
+	// First byte of the mapping, null for an empty file
+	void* data() const;
+	// Length of the file in bytes
+	std::size_t size() const;
+	// Hints how a byte range is about to be used, false if the hint was not taken
+	bool advise(Access access, std::size_t offset, std::size_t length);
+	// Writes the changed pages back to the file and waits for them
+	bool sync();
+	// Unmaps and closes the file, returns false if either failed
+	bool close();
+	// Whether files can be mapped on this system
+	static bool supported();
+
+private:
+#if defined(_WIN32)
+	HANDLE file;                                    ///< Open file, INVALID_HANDLE_VALUE if none
+	HANDLE mapping;                                 ///< File mapping object, null if none
+#elif defined(__unix__) || defined(__APPLE__)
+	int descriptor;                                 ///< Open file, -1 if none
+#endif
+	void* address;                                  ///< First byte of the mapping
+	std::size_t bytes;                              ///< Length of the mapping
+};
+
+// ----------------------------------------------------------------------------
+// Builds a closed file.
+// ----------------------------------------------------------------------------
+#if defined(_WIN32)
+inline MappedFile::MappedFile()
+    : file(INVALID_HANDLE_VALUE), mapping(nullptr), address(nullptr), bytes(0) {}
+#elif defined(__unix__) || defined(__APPLE__)
+inline MappedFile::MappedFile() : descriptor(-1), address(nullptr), bytes(0) {}
+#else
+inline MappedFile::MappedFile() : address(nullptr), bytes(0) {}
+#endif
+
+// ----------------------------------------------------------------------------
+// Unmaps and closes the file. Dirty pages still reach the file through the
+// page cache, only later.
+// ----------------------------------------------------------------------------
+inline MappedFile::~MappedFile() {
+    close();
+}
+
+// ----------------------------------------------------------------------------
+// Maps a whole file for reading and writing.
+// @param [in] path Path of an existing file.
+// @note The mapping is shared, so writes through it change the file and no
+// copy of its contents is made. An empty file opens with a null mapping,
+// since nothing can be mapped.
+// @returns true if the file is open and mapped.
+// ----------------------------------------------------------------------------
+inline bool MappedFile::open(const std::string& path) {
+    close();
+#if defined(_WIN32)
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER length;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length)
+        || static_cast<std::uint64_t>(length.QuadPart) > (std::numeric_limits<std::size_t>::max)()) {
+        close();
+        return false;
+    }
+    bytes = static_cast<std::size_t>(length.QuadPart);
+    if (bytes == 0) {
+        return true;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    address = mapping == nullptr ? nullptr : MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (address == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+#elif defined(__unix__) || defined(__APPLE__)
+    struct stat status;
+    descriptor = ::open(path.c_str(), O_RDWR);
+    if (descriptor < 0 || fstat(descriptor, &status) != 0
+        || static_cast<std::uint64_t>(status.st_size) > (std::numeric_limits<std::size_t>::max)()) {
+        close();
+        return false;
+    }
+    bytes = static_cast<std::size_t>(status.st_size);
+    if (bytes == 0) {
+        return true;
+    }
+    address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+        close();
+        return false;
+    }
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Accessors of the mapping.
+// ----------------------------------------------------------------------------
+inline void* MappedFile::data() const {
+    return address;
+}
+
+inline std::size_t MappedFile::size() const {
+    return bytes;
+}
+
+// ----------------------------------------------------------------------------
+// Hints to the kernel how a byte range of the mapping is about to be used.
+// @param [in] access The coming access pattern.
+// @param [in] offset First byte of the range, rounded down to a page.
+// @param [in] length Length of the range in bytes, clipped to the mapping.
+// @note Only a hint, the sort is correct whether or not it is taken. It is
+// never taken on Windows.
+// @returns true if the kernel accepted the hint.
+// ----------------------------------------------------------------------------
+inline bool MappedFile::advise(Access access, std::size_t offset, std::size_t length) {
+#if defined(_WIN32)
+    (void)access;
+    (void)offset;
+    (void)length;
+    return false;
+#elif defined(__unix__) || defined(__APPLE__)
+    if (address == nullptr || offset >= bytes) {
+        return false;
+    }
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t start = offset / page * page;
+    const std::size_t end = length < bytes - offset ? offset + length : bytes;
+    const int advice = access == Access::sequential ? MADV_SEQUENTIAL
+                     : access == Access::random ? MADV_RANDOM
+                     : access == Access::willneed ? MADV_WILLNEED
+                     : MADV_NORMAL;
+    return madvise(static_cast<char*>(address) + start, end - start, advice) == 0;
+#else
+    (void)access;
+    (void)offset;
+    (void)length;
+    return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Writes the changed pages back to the file and waits for the writes.
+// @returns true if the file holds the mapping's contents, trivially for an
+// empty file.
+// ----------------------------------------------------------------------------
+inline bool MappedFile::sync() {
+    if (address == nullptr) {
+        return bytes == 0;
+    }
+#if defined(_WIN32)
+    return FlushViewOfFile(address, 0) && FlushFileBuffers(file);
+#elif defined(__unix__) || defined(__APPLE__)
+    return msync(address, bytes, MS_SYNC) == 0;
+#else
+    return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Unmaps and closes the file.
+// @returns true if the file was open and both steps succeeded.
+// ----------------------------------------------------------------------------
+inline bool MappedFile::close() {
+    bool closed = false;
+#if defined(_WIN32)
+    closed = file != INVALID_HANDLE_VALUE;
+    if (address != nullptr) {
+        closed = UnmapViewOfFile(address) && closed;
+    }
+    if (mapping != nullptr) {
+        closed = CloseHandle(mapping) && closed;
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        closed = CloseHandle(file) && closed;
+    }
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#elif defined(__unix__) || defined(__APPLE__)
+    closed = descriptor >= 0;
+    if (address != nullptr) {
+        closed = munmap(address, bytes) == 0 && closed;
+    }
+    if (descriptor >= 0) {
+        closed = ::close(descriptor) == 0 && closed;
+    }
+    descriptor = -1;
+#endif
+    address = nullptr;
+    bytes = 0;
+    return closed;
+}
+
+// ----------------------------------------------------------------------------
+// Whether files can be mapped on this system.
+// ----------------------------------------------------------------------------
+inline bool MappedFile::supported() {
+#if defined(_WIN32) || defined(__unix__) || defined(__APPLE__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif  /* MAPPEDFILE_H_ */
@@ -0,0 +1,189 @@
+/// @file: MergeFunnel.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements a buffered merge tree, a funnel, which
+/// merges k sorted runs in one pass over memory. Every internal node is a
+/// two-way merge into a small buffer, and the buffers together fit in the
+/// cache. Elements then cross main memory once per k-way merge, while every
+/// comparison stays a branch-free two-way step, Sort's own merge kernel,
+/// which the funnel reaches as a friend of Sort.
+
+#ifndef MERGEFUNNEL_H_
+#define MERGEFUNNEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Sort.h"
+
+/// ----------------------------------------------------------------------------
+///                            MergeFunnel Class
+/// ----------------------------------------------------------------------------
+template <class T, class Less>
+class MergeFunnel {
+public:
+	// Builds a funnel for up to ways runs, each node buffering bufferSize elements
+	MergeFunnel(std::size_t ways, std::size_t bufferSize, Less& less);
+
+	// Merges sorted runs, no more than ways of them, and returns the output's end
+	T* merge(const std::vector<std::pair<const T*, const T*>>& runs, T* out);
+
+private:
+	// Writes up to capacity merged elements of a node's children to out
+	std::size_t produce(std::size_t node, T* out, std::size_t capacity);
+	// Refills the buffer of an internal node from its children
+	void refill(std::size_t node);
+
+	std::size_t ways;                   ///< Most runs merged at once
+	std::size_t leaves;                 ///< Runs the current merge uses, a power of two
+	std::size_t bufferSize;             ///< Elements buffered by each internal node
+	std::vector<T> buffers;             ///< Buffer of node i at i * bufferSize
+	std::vector<const T*> heads;        ///< Next element of each node
+	std::vector<const T*> tails;        ///< One past the buffered elements of each node
+	std::vector<bool> more;             ///< Whether a node can still be refilled
+	Less& less;                         ///< Projected comparator
+};
+
+// ----------------------------------------------------------------------------
+// Builds the funnel and its buffers, reused by every merge.
+// @param [in] ways Largest number of runs merged at once.
+// @param [in] bufferSize Elements buffered by every internal node.
+// @param [in] less The projected comparator.
+// @note The root writes to the output directly, so node 1 needs no buffer.
+// ----------------------------------------------------------------------------
+template <class T, class Less>
+MergeFunnel<T, Less>::MergeFunnel(std::size_t ways, std::size_t bufferSize, Less& less)
+    : ways(2), leaves(2), bufferSize(bufferSize > 0 ? bufferSize : 1), less(less) {
+    while (this->ways < ways) {
+        this->ways *= 2;
+    }
+    buffers.resize(this->ways * this->bufferSize);
+    heads.resize(2 * this->ways);
+    tails.resize(2 * this->ways);
+    more.resize(2 * this->ways);
+}
+
+// ----------------------------------------------------------------------------
+// Merges sorted runs into one sorted output.
+// @param [in] runs First and last pointer of every sorted run.
+// @param [out] out The beginning of the destination, as long as the runs.
+// @note Run i is leaf k + i of an implicit binary tree whose internal nodes
+// are 1 to k - 1, with k the run count rounded up to a power of two. Equal
+// keys come out in the order of their runs, keeping it stable.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class T, class Less>
+T* MergeFunnel<T, Less>::merge(const std::vector<std::pair<const T*, const T*>>& runs, T* out) {
+    std::size_t size = 0;                           // Elements to merge
+
+    leaves = 2;
+    while (leaves < runs.size()) {
+        leaves *= 2;
+    }
+
+    // Leaves read their runs in place, missing runs are empty.
+    for (std::size_t leaf = 0; leaf < leaves; leaf++) {
+        const std::size_t node = leaves + leaf;
+        heads[node] = leaf < runs.size() ? runs[leaf].first : nullptr;
+        tails[node] = leaf < runs.size() ? runs[leaf].second : nullptr;
+        more[node] = false;
+        size += static_cast<std::size_t>(tails[node] - heads[node]);
+    }
+    // Internal nodes start empty and refill on first use.
+    for (std::size_t node = 1; node < leaves; node++) {
+        heads[node] = tails[node] = nullptr;
+        more[node] = true;
+    }
+
+    return out + produce(1, out, size);
+}
+
+// ----------------------------------------------------------------------------
+// Merges the buffered elements of a node's two children.
+// @param [in] node The internal node.
+// @param [out] out The destination.
+// @param [in] capacity Most elements to write.
+// @note Neither child can run dry within as many steps as the shorter one
+// holds. Those steps are co-ranked, finding how many of them come from the
+// left, then merged from both ends at once by Sort::merge. Children are
+// refilled between rounds.
+// @returns the elements written, short of capacity only once both children
+// are used up.
+// ----------------------------------------------------------------------------
+template <class T, class Less>
+std::size_t MergeFunnel<T, Less>::produce(std::size_t node, T* out, std::size_t capacity) {
+    const std::size_t left = 2 * node;             // Left child, ties go to it
+    const std::size_t right = 2 * node + 1;        // Right child
+    std::size_t produced = 0;                       // Elements written so far
+
+    while (produced < capacity) {
+        if (heads[left] == tails[left] && more[left]) {
+            refill(left);
+        }
+        if (heads[right] == tails[right] && more[right]) {
+            refill(right);
+        }
+        const std::size_t leftSize = static_cast<std::size_t>(tails[left] - heads[left]);
+        const std::size_t rightSize = static_cast<std::size_t>(tails[right] - heads[right]);
+        const std::size_t space = capacity - produced;
+
+        // Both children used up
+        if (leftSize == 0 && rightSize == 0) {
+            break;
+        }
+
+        // One child used up, the other is copied across.
+        if (leftSize == 0 || rightSize == 0) {
+            const std::size_t child = leftSize == 0 ? right : left;
+            const std::size_t count = std::min(space, leftSize + rightSize);
+            std::copy(heads[child], heads[child] + count, out + produced);
+            heads[child] += count;
+            produced += count;
+            continue;
+        }
+
+        const std::size_t steps = std::min(space, std::min(leftSize, rightSize));
+        const T* first1 = heads[left];
+        const T* first2 = heads[right];
+
+        // Fewest left elements whose next one sorts after the right element
+        // taken last, equal keys staying left
+        std::size_t low = 0;
+        std::size_t high = steps;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (less(first2[steps - middle - 1], first1[middle])) {
+                high = middle;
+            }
+            else {
+                low = middle + 1;
+            }
+        }
+
+        Sort::merge(first1, first1 + low, first2, first2 + (steps - low), out + produced, less,
+                    std::true_type());
+        heads[left] = first1 + low;
+        heads[right] = first2 + (steps - low);
+        produced += steps;
+    }
+    return produced;
+}
+
+// ----------------------------------------------------------------------------
+// Refills the buffer of an internal node, or marks it used up.
+// @param [in] node The internal node, below the root.
+// ----------------------------------------------------------------------------
+template <class T, class Less>
+void MergeFunnel<T, Less>::refill(std::size_t node) {
+    T* buffer = buffers.data() + node * bufferSize;
+    const std::size_t count = produce(node, buffer, bufferSize);
+
+    heads[node] = buffer;
+    tails[node] = buffer + count;
+    more[node] = count == bufferSize;
+}
+
+#endif  /* MERGEFUNNEL_H_ */
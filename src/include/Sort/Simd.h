@@ -0,0 +1,1146 @@
+/// @file: Simd.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements the vectorized kernels used by the sorting
+/// algorithms, bitonic sorting networks for small blocks of ints and
+/// partitioning of int, int64, float and double arrays, built on SSE4.2,
+/// AVX2 and AVX-512 with a scalar fallback. The kernels of the best tier the
+/// CPU supports are picked once at run time, so one binary serves every host.
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// The vector kernels are compiled through target attributes, so the rest of
+// the program needs no -mavx2 and still runs on older hosts.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+/// ----------------------------------------------------------------------------
+///                             Simd Class
+/// ----------------------------------------------------------------------------
+class Simd {
+public:
+	// Instruction set tiers of the kernels, slowest first
+	enum class Tier { scalar, sse42, avx2, avx512 };
+
+	// Longest block the sorting networks sort
+	static constexpr std::size_t NETWORK_MAX = 256;
+
+	// Sorts up to NETWORK_MAX ints ascending with the active network
+	static void sort_network(int* data, std::size_t count);
+	// Moves the values below a pivot to the front with the active kernel
+	static std::size_t partition(int* data, std::size_t count, int pivot);
+	static std::size_t partition(std::int64_t* data, std::size_t count, std::int64_t pivot);
+	static std::size_t partition(float* data, std::size_t count, float pivot);
+	static std::size_t partition(double* data, std::size_t count, double pivot);
+
+	// Best tier the CPU supports
+	static Tier best_tier();
+	// Tier of the active kernels
+	static Tier tier();
+	// Switches to the kernels of a tier, capped to the best the CPU supports
+	static Tier select(Tier tier);
+	// Name of a tier, as accepted by the SORT_SIMD environment variable
+	static const char* tier_name(Tier tier);
+	// Name of the active kernels, for benchmark reports
+	static const char* kernel_name();
+
+private:
+	// Entry points of one tier, the active table is looked up once per call
+	struct kernel_table {
+		Tier tier;                                                      ///< Tier of the kernels
+		void (*sortNetwork)(int*, std::size_t);                         ///< Sorting network
+		std::size_t (*partitionInt)(int*, std::size_t, int);            ///< int partition
+		std::size_t (*partitionInt64)(std::int64_t*, std::size_t,
+		                              std::int64_t);                    ///< int64 partition
+		std::size_t (*partitionFloat)(float*, std::size_t, float);      ///< float partition
+		std::size_t (*partitionDouble)(double*, std::size_t, double);   ///< double partition
+	};
+
+	// Table of the kernels of a tier the CPU supports
+	static const kernel_table& table(Tier tier);
+	// Active table, empty until the first call picks one
+	static std::atomic<const kernel_table*>& active();
+	// Active table, picked on first use
+	static const kernel_table& kernels();
+	// Best tier, lowered by the SORT_SIMD environment variable
+	static Tier startup_tier();
+
+	// Scalar fallback used without SSE4.2
+	static void network_scalar(int* data, std::size_t count);
+#if SIMD_X86
+	// Bitonic network over 4 lane SSE4.2 registers
+	SIMD_TARGET("sse4.2") static void network_sse42(int* data, std::size_t count);
+	// Bitonic network over 8 lane AVX2 registers
+	SIMD_TARGET("avx2") static void network_avx2(int* data, std::size_t count);
+	// Bitonic network over 16 lane AVX-512 registers
+	SIMD_TARGET("avx512f") static void network_avx512(int* data, std::size_t count);
+	// Compare-exchanges the lanes of one SSE4.2 register at a distance
+	SIMD_TARGET("sse4.2") static __m128i exchange_sse42(__m128i vector, int distance,
+	                                                   bool mirror);
+	// Compare-exchanges the lanes of one AVX2 register at a distance
+	SIMD_TARGET("avx2") static __m256i exchange_avx2(__m256i vector, int distance, bool mirror);
+	// Compare-exchanges the lanes of one AVX-512 register at a distance
+	SIMD_TARGET("avx512f") static __m512i exchange_avx512(__m512i vector, int distance,
+	                                                     bool mirror);
+#endif
+	// Smallest power of two holding count, at least minimum
+	static std::size_t network_size(std::size_t count, std::size_t minimum);
+
+	// Branch-free scalar partition used without SSE4.2 and for short arrays
+	template <class T>
+	static std::size_t partition_scalar(T* data, std::size_t count, T pivot);
+	// Distributes buffered values to both ends of the unwritten gap
+	template <class T>
+	static std::size_t partition_rest(T* data, std::size_t writeLeft, std::size_t writeRight,
+	                                  const T* rest, std::size_t count, T pivot);
+#if SIMD_X86
+	// Partition loop over SSE4.2 registers
+	template <class T>
+	SIMD_TARGET("sse4.2") static std::size_t partition_sse42(T* data, std::size_t count,
+	                                                        T pivot);
+	// Partition loop over AVX2 registers
+	template <class T>
+	SIMD_TARGET("avx2") static std::size_t partition_avx2(T* data, std::size_t count, T pivot);
+	// Partition loop over AVX-512 registers
+	template <class T>
+	SIMD_TARGET("avx512f") static std::size_t partition_avx512(T* data, std::size_t count,
+	                                                          T pivot);
+	// Splits one SSE4.2 register of values around the pivot into both ends
+	SIMD_TARGET("sse4.2") static std::size_t compress_sse42(const int* source, int* left,
+	                                                       int* right, int pivot);
+	SIMD_TARGET("sse4.2") static std::size_t compress_sse42(const std::int64_t* source,
+	                                                       std::int64_t* left,
+	                                                       std::int64_t* right,
+	                                                       std::int64_t pivot);
+	SIMD_TARGET("sse4.2") static std::size_t compress_sse42(const float* source, float* left,
+	                                                       float* right, float pivot);
+	SIMD_TARGET("sse4.2") static std::size_t compress_sse42(const double* source,
+	                                                       double* left, double* right,
+	                                                       double pivot);
+	// Splits one AVX2 register of values around the pivot into both ends
+	SIMD_TARGET("avx2") static std::size_t compress_avx2(const int* source, int* left,
+	                                                     int* right, int pivot);
+	SIMD_TARGET("avx2") static std::size_t compress_avx2(const std::int64_t* source,
+	                                                     std::int64_t* left, std::int64_t* right,
+	                                                     std::int64_t pivot);
+	SIMD_TARGET("avx2") static std::size_t compress_avx2(const float* source, float* left,
+	                                                     float* right, float pivot);
+	SIMD_TARGET("avx2") static std::size_t compress_avx2(const double* source, double* left,
+	                                                     double* right, double pivot);
+	// Splits one AVX-512 register of values around the pivot into both ends
+	SIMD_TARGET("avx512f") static std::size_t compress_avx512(const int* source, int* left,
+	                                                         int* right, int pivot);
+	SIMD_TARGET("avx512f") static std::size_t compress_avx512(const std::int64_t* source,
+	                                                         std::int64_t* left,
+	                                                         std::int64_t* right,
+	                                                         std::int64_t pivot);
+	SIMD_TARGET("avx512f") static std::size_t compress_avx512(const float* source, float* left,
+	                                                         float* right, float pivot);
+	SIMD_TARGET("avx512f") static std::size_t compress_avx512(const double* source,
+	                                                         double* left, double* right,
+	                                                         double pivot);
+	// Byte orders moving the masked lanes of an SSE4.2 register to its front
+	SIMD_TARGET("sse4.2") static __m128i compress_bytes(unsigned mask, bool wide);
+	// Lane orders moving the masked lanes of an AVX2 register to its front
+	SIMD_TARGET("avx2") static __m256i compress_order(unsigned mask, bool wide);
+#endif
+};
+
+// ----------------------------------------------------------------------------
+// Sorts a small block of ints in ascending order.
+// @param [in] data The block to sort.
+// @param [in] count Number of ints, at most NETWORK_MAX.
+// @note Runs the network of the active tier, no CPU check is made per call.
+// ----------------------------------------------------------------------------
+inline void Simd::sort_network(int* data, std::size_t count) {
+    kernels().sortNetwork(data, count);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions an array around a pivot value.
+// @param [in] data The array to partition.
+// @param [in] count Number of values in the array.
+// @param [in] pivot The value to partition around.
+// @note Values below the pivot end up in front, the rest behind them, in no
+// particular order within either side.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+inline std::size_t Simd::partition(int* data, std::size_t count, int pivot) {
+    return kernels().partitionInt(data, count, pivot);
+}
+
+inline std::size_t Simd::partition(std::int64_t* data, std::size_t count, std::int64_t pivot) {
+    return kernels().partitionInt64(data, count, pivot);
+}
+
+inline std::size_t Simd::partition(float* data, std::size_t count, float pivot) {
+    return kernels().partitionFloat(data, count, pivot);
+}
+
+inline std::size_t Simd::partition(double* data, std::size_t count, double pivot) {
+    return kernels().partitionDouble(data, count, pivot);
+}
+
+// ----------------------------------------------------------------------------
+// Detects the widest vector instruction set of the CPU.
+// @returns the best tier the kernels can use on this host.
+// ----------------------------------------------------------------------------
+inline Simd::Tier Simd::best_tier() {
+#if SIMD_X86
+    return __builtin_cpu_supports("avx512f") ? Tier::avx512
+         : __builtin_cpu_supports("avx2") ? Tier::avx2
+         : __builtin_cpu_supports("sse4.2") ? Tier::sse42 : Tier::scalar;
+#else
+    return Tier::scalar;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Tier of the kernels the sorts are using.
+// @returns the active tier.
+// ----------------------------------------------------------------------------
+inline Simd::Tier Simd::tier() {
+    return kernels().tier;
+}
+
+// ----------------------------------------------------------------------------
+// Switches every later call to the kernels of a tier, for comparing them on
+// one host.
+// @param [in] tier The tier wanted, a tier the CPU lacks falls back to the
+// best one it has.
+// @note Must not race with sorts using the kernels of another thread.
+// @returns the tier selected.
+// ----------------------------------------------------------------------------
+inline Simd::Tier Simd::select(Tier tier) {
+    if (tier > best_tier()) {
+        tier = best_tier();
+    }
+    active().store(&table(tier), std::memory_order_release);
+    return tier;
+}
+
+// ----------------------------------------------------------------------------
+// Name of a tier.
+// @param [in] tier The tier.
+// @returns "scalar", "sse4.2", "avx2" or "avx512".
+// ----------------------------------------------------------------------------
+inline const char* Simd::tier_name(Tier tier) {
+    static const char* const names[] = {"scalar", "sse4.2", "avx2", "avx512"};
+    return names[static_cast<int>(tier)];
+}
+
+// ----------------------------------------------------------------------------
+// Name of the kernels the sorts are using.
+// @returns the name of the active tier.
+// ----------------------------------------------------------------------------
+inline const char* Simd::kernel_name() {
+    return tier_name(tier());
+}
+
+// ----------------------------------------------------------------------------
+// Table of the kernels of a tier.
+// @param [in] tier The tier, at most best_tier().
+// @note The tables hold only addresses, so they are built at compile time.
+// @returns the entry points of the tier.
+// ----------------------------------------------------------------------------
+inline const Simd::kernel_table& Simd::table(Tier tier) {
+    static const kernel_table tables[] = {
+        {Tier::scalar, &network_scalar, &partition_scalar<int>,
+         &partition_scalar<std::int64_t>, &partition_scalar<float>, &partition_scalar<double>},
+#if SIMD_X86
+        {Tier::sse42, &network_sse42, &partition_sse42<int>,
+         &partition_sse42<std::int64_t>, &partition_sse42<float>, &partition_sse42<double>},
+        {Tier::avx2, &network_avx2, &partition_avx2<int>,
+         &partition_avx2<std::int64_t>, &partition_avx2<float>, &partition_avx2<double>},
+        {Tier::avx512, &network_avx512, &partition_avx512<int>,
+         &partition_avx512<std::int64_t>, &partition_avx512<float>, &partition_avx512<double>},
+#endif
+    };
+    return tables[static_cast<int>(tier)];
+}
+
+// ----------------------------------------------------------------------------
+// Slot holding the active table.
+// @note The atomic is constant initialized, so reading it costs no guard.
+// @returns the slot, null until a table is picked.
+// ----------------------------------------------------------------------------
+inline std::atomic<const Simd::kernel_table*>& Simd::active() {
+    static std::atomic<const kernel_table*> current(nullptr);
+    return current;
+}
+
+// ----------------------------------------------------------------------------
+// Active table, picked on the first call.
+// @note The CPU is inspected once, later calls only load the table pointer.
+// A select() made before the first call wins over the startup pick.
+// @returns the entry points of the active tier.
+// ----------------------------------------------------------------------------
+inline const Simd::kernel_table& Simd::kernels() {
+    const kernel_table* current = active().load(std::memory_order_acquire);
+
+    if (current == nullptr) {
+        const kernel_table* picked = &table(startup_tier());
+        // Racing first calls pick the same table, only one is stored
+        if (active().compare_exchange_strong(current, picked, std::memory_order_acq_rel)) {
+            current = picked;
+        }
+    }
+    return *current;
+}
+
+// ----------------------------------------------------------------------------
+// Picks the tier used from startup.
+// @note SORT_SIMD set to a tier name forces that tier, so kernels can be
+// compared on one host. Tiers above the CPU's best and unknown names are
+// ignored.
+// @returns the tier to start with.
+// ----------------------------------------------------------------------------
+inline Simd::Tier Simd::startup_tier() {
+    const Tier best = best_tier();
+    const char* forced = std::getenv("SORT_SIMD");
+
+    if (forced != nullptr) {
+        for (int index = 0; index <= static_cast<int>(best); index++) {
+            if (std::strcmp(forced, tier_name(static_cast<Tier>(index))) == 0) {
+                return static_cast<Tier>(index);
+            }
+        }
+    }
+    return best;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a small block of ints with insertion sort, for hosts without SSE4.2.
+// @param [in] data The block to sort.
+// @param [in] count Number of ints.
+// ----------------------------------------------------------------------------
+inline void Simd::network_scalar(int* data, std::size_t count) {
+    for (std::size_t index = 1; index < count; index++) {
+        const int value = data[index];
+        std::size_t hole = index;
+
+        while (hole > 0 && value < data[hole - 1]) {
+            data[hole] = data[hole - 1];
+            --hole;
+        }
+        data[hole] = value;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Rounds a block length up to the network size sorting it.
+// @param [in] count Number of elements in the block.
+// @param [in] minimum Smallest network, one vector register.
+// @returns the smallest power of two at least count and minimum.
+// ----------------------------------------------------------------------------
+inline std::size_t Simd::network_size(std::size_t count, std::size_t minimum) {
+    std::size_t size = minimum;
+    while (size < count) {
+        size *= 2;
+    }
+    return size;
+}
+
+// ----------------------------------------------------------------------------
+// Partitions an array around a pivot without vector instructions.
+// @param [in] data The array to partition.
+// @param [in] count Number of values in the array.
+// @param [in] pivot The value to partition around.
+// @note Every value is swapped into the boundary slot, which only advances
+// for values below the pivot, so the loop has no data dependent branch.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+template <class T>
+std::size_t Simd::partition_scalar(T* data, std::size_t count, T pivot) {
+    std::size_t boundary = 0;          // End of the values below the pivot
+
+    for (std::size_t index = 0; index < count; index++) {
+        const T value = data[index];
+        data[index] = data[boundary];
+        data[boundary] = value;
+        boundary += value < pivot;
+    }
+    return boundary;
+}
+
+// ----------------------------------------------------------------------------
+// Writes buffered values into the unwritten gap of a vector partition.
+// @param [in] data The array being partitioned.
+// @param [in] writeLeft Start of the gap, next slot for a lower value.
+// @param [in] writeRight End of the gap, one past the next upper slot.
+// @param [in] rest The buffered values, exactly as many as the gap holds.
+// @param [in] count Number of buffered values.
+// @param [in] pivot The value to partition around.
+// @returns the number of values below the pivot in the whole array.
+// ----------------------------------------------------------------------------
+template <class T>
+std::size_t Simd::partition_rest(T* data, std::size_t writeLeft, std::size_t writeRight,
+                                 const T* rest, std::size_t count, T pivot) {
+    for (std::size_t index = 0; index < count; index++) {
+        const T value = rest[index];
+        const bool below = value < pivot;
+
+        data[below ? writeLeft : writeRight - 1] = value;
+        writeLeft += below;
+        writeRight -= !below;
+    }
+    return writeLeft;
+}
+
+#if SIMD_X86
+// Older GCC flags the undefined passthrough inside the AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// ----------------------------------------------------------------------------
+// Sorts a small block of ints with a bitonic network of SSE4.2 registers.
+// @param [in] data The block to sort.
+// @param [in] count Number of ints, at most NETWORK_MAX.
+// @note Same network as the AVX2 kernel over 4 lane registers, lanes within
+// a register are permuted with byte shuffles.
+// ----------------------------------------------------------------------------
+inline void Simd::network_sse42(int* data, std::size_t count) {
+    constexpr std::size_t lanes = 4;                       // Ints per register
+    const std::size_t size = network_size(count, lanes);   // Padded length
+    const std::size_t registers = size / lanes;            // Registers in use
+    __m128i vectors[NETWORK_MAX / lanes];                   // The padded block
+    alignas(16) int tail[lanes];                           // Last partial register
+
+    // Load whole registers, then the padded remainder
+    const std::size_t whole = count / lanes;
+    for (std::size_t index = 0; index < whole; index++) {
+        vectors[index] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index * lanes));
+    }
+    for (std::size_t index = whole; index < registers; index++) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            const std::size_t position = index * lanes + lane;
+            tail[lane] = position < count ? data[position] : INT_MAX;
+        }
+        vectors[index] = _mm_load_si128(reinterpret_cast<const __m128i*>(tail));
+    }
+
+    for (std::size_t stage = 2; stage <= size; stage *= 2) {
+        // Mirror step of the stage
+        if (stage <= lanes) {
+            for (std::size_t index = 0; index < registers; index++) {
+                vectors[index] = exchange_sse42(vectors[index], static_cast<int>(stage - 1), true);
+            }
+        }
+        else {
+            const std::size_t span = stage / lanes;        // Registers per stage block
+            for (std::size_t index = 0; index < registers; index++) {
+                const std::size_t partner = index ^ (span - 1);
+                if (index < partner) {
+                    __m128i mirrored = _mm_shuffle_epi32(vectors[partner], _MM_SHUFFLE(0, 1, 2, 3));
+                    __m128i low = _mm_min_epi32(vectors[index], mirrored);
+                    __m128i high = _mm_max_epi32(vectors[index], mirrored);
+                    vectors[index] = low;
+                    vectors[partner] = _mm_shuffle_epi32(high, _MM_SHUFFLE(0, 1, 2, 3));
+                }
+            }
+        }
+        // Halving steps of the stage
+        for (std::size_t distance = stage / 4; distance > 0; distance /= 2) {
+            if (distance < lanes) {
+                for (std::size_t index = 0; index < registers; index++) {
+                    vectors[index] = exchange_sse42(vectors[index], static_cast<int>(distance),
+                                                    false);
+                }
+            }
+            else {
+                const std::size_t step = distance / lanes;     // Registers apart
+                for (std::size_t index = 0; index < registers; index++) {
+                    if ((index & step) == 0) {
+                        __m128i low = _mm_min_epi32(vectors[index], vectors[index + step]);
+                        __m128i high = _mm_max_epi32(vectors[index], vectors[index + step]);
+                        vectors[index] = low;
+                        vectors[index + step] = high;
+                    }
+                }
+            }
+        }
+    }
+
+    // Store whole registers, then the unpadded remainder
+    for (std::size_t index = 0; index < whole; index++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + index * lanes), vectors[index]);
+    }
+    if (whole < registers) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(tail), vectors[whole]);
+        for (std::size_t lane = 0; whole * lanes + lane < count; lane++) {
+            data[whole * lanes + lane] = tail[lane];
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Compare-exchanges lanes of one SSE4.2 register.
+// @param [in] vector The register.
+// @param [in] distance Lane distance, the mask XORed into a lane index.
+// @param [in] mirror Whether the distance is a mirror mask of all low bits.
+// @returns the register with the lower lane of every pair holding the min.
+// ----------------------------------------------------------------------------
+inline __m128i Simd::exchange_sse42(__m128i vector, int distance, bool mirror) {
+    // Highest bit of the distance, set in the upper lane of every pair
+    const __m128i upper = _mm_set1_epi32(mirror ? (distance + 1) / 2 : distance);
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i partners = _mm_xor_si128(lanes, _mm_set1_epi32(distance));
+    const __m128i takeMax = _mm_cmpeq_epi32(_mm_and_si128(lanes, upper), upper);
+    // Byte indices of the partner lanes, 4 * partner + 0, 1, 2, 3
+    const __m128i bytes = _mm_add_epi32(_mm_mullo_epi32(partners, _mm_set1_epi32(0x04040404)),
+                                        _mm_set1_epi32(0x03020100));
+
+    __m128i swapped = _mm_shuffle_epi8(vector, bytes);
+    __m128i low = _mm_min_epi32(vector, swapped);
+    __m128i high = _mm_max_epi32(vector, swapped);
+    return _mm_blendv_epi8(low, high, takeMax);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a small block of ints with a bitonic network of AVX2 registers.
+// @param [in] data The block to sort.
+// @param [in] count Number of ints, at most NETWORK_MAX.
+// @note The block is padded with INT_MAX up to a power of two. Every merge
+// stage of size k first compares each element with its mirror in its k
+// block, then halves the compare distance, so every exchange sends the
+// minimum to the lower index and no direction bookkeeping is needed.
+// Distances of a register or more compare whole registers, shorter ones
+// permute the lanes of a single register.
+// ----------------------------------------------------------------------------
+inline void Simd::network_avx2(int* data, std::size_t count) {
+    constexpr std::size_t lanes = 8;                       // Ints per register
+    const std::size_t size = network_size(count, lanes);   // Padded length
+    const std::size_t registers = size / lanes;            // Registers in use
+    __m256i vectors[NETWORK_MAX / lanes];                   // The padded block
+    alignas(32) int tail[lanes];                           // Last partial register
+
+    // Load whole registers, then the padded remainder
+    const std::size_t whole = count / lanes;
+    for (std::size_t index = 0; index < whole; index++) {
+        vectors[index] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index * lanes));
+    }
+    for (std::size_t index = whole; index < registers; index++) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            const std::size_t position = index * lanes + lane;
+            tail[lane] = position < count ? data[position] : INT_MAX;
+        }
+        vectors[index] = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+    }
+
+    // Reverses the lanes of a register
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (std::size_t stage = 2; stage <= size; stage *= 2) {
+        // Mirror step of the stage
+        if (stage <= lanes) {
+            for (std::size_t index = 0; index < registers; index++) {
+                vectors[index] = exchange_avx2(vectors[index], static_cast<int>(stage - 1), true);
+            }
+        }
+        else {
+            const std::size_t span = stage / lanes;        // Registers per stage block
+            for (std::size_t index = 0; index < registers; index++) {
+                const std::size_t partner = index ^ (span - 1);
+                if (index < partner) {
+                    __m256i mirrored = _mm256_permutevar8x32_epi32(vectors[partner], reverse);
+                    __m256i low = _mm256_min_epi32(vectors[index], mirrored);
+                    __m256i high = _mm256_max_epi32(vectors[index], mirrored);
+                    vectors[index] = low;
+                    vectors[partner] = _mm256_permutevar8x32_epi32(high, reverse);
+                }
+            }
+        }
+        // Halving steps of the stage
+        for (std::size_t distance = stage / 4; distance > 0; distance /= 2) {
+            if (distance < lanes) {
+                for (std::size_t index = 0; index < registers; index++) {
+                    vectors[index] = exchange_avx2(vectors[index], static_cast<int>(distance), false);
+                }
+            }
+            else {
+                const std::size_t step = distance / lanes;     // Registers apart
+                for (std::size_t index = 0; index < registers; index++) {
+                    if ((index & step) == 0) {
+                        __m256i low = _mm256_min_epi32(vectors[index], vectors[index + step]);
+                        __m256i high = _mm256_max_epi32(vectors[index], vectors[index + step]);
+                        vectors[index] = low;
+                        vectors[index + step] = high;
+                    }
+                }
+            }
+        }
+    }
+
+    // Store whole registers, then the unpadded remainder
+    for (std::size_t index = 0; index < whole; index++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + index * lanes), vectors[index]);
+    }
+    if (whole < registers) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(tail), vectors[whole]);
+        for (std::size_t lane = 0; whole * lanes + lane < count; lane++) {
+            data[whole * lanes + lane] = tail[lane];
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Compare-exchanges lanes of one AVX2 register.
+// @param [in] vector The register.
+// @param [in] distance Lane distance, the mask XORed into a lane index.
+// @param [in] mirror Whether the distance is a mirror mask of all low bits.
+// @returns the register with the lower lane of every pair holding the min.
+// ----------------------------------------------------------------------------
+inline __m256i Simd::exchange_avx2(__m256i vector, int distance, bool mirror) {
+    // Highest bit of the distance, set in the upper lane of every pair
+    const __m256i upper = _mm256_set1_epi32(mirror ? (distance + 1) / 2 : distance);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i partners = _mm256_xor_si256(lanes, _mm256_set1_epi32(distance));
+    const __m256i takeMax = _mm256_cmpeq_epi32(_mm256_and_si256(lanes, upper), upper);
+
+    __m256i swapped = _mm256_permutevar8x32_epi32(vector, partners);
+    __m256i low = _mm256_min_epi32(vector, swapped);
+    __m256i high = _mm256_max_epi32(vector, swapped);
+    return _mm256_blendv_epi8(low, high, takeMax);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a small block of ints with a bitonic network of AVX-512 registers.
+// @param [in] data The block to sort.
+// @param [in] count Number of ints, at most NETWORK_MAX.
+// @note Same network as the AVX2 kernel over 16 lane registers, the padded
+// tail is loaded and stored with lane masks. Blocks of up to 8 ints go to
+// the AVX2 kernel instead.
+// ----------------------------------------------------------------------------
+inline void Simd::network_avx512(int* data, std::size_t count) {
+    constexpr std::size_t lanes = 16;                      // Ints per register
+
+    // Half a register of padding would be wasted work
+    if (count <= lanes / 2) {
+        network_avx2(data, count);
+        return;
+    }
+
+    const std::size_t size = network_size(count, lanes);   // Padded length
+    const std::size_t registers = size / lanes;            // Registers in use
+    __m512i vectors[NETWORK_MAX / lanes];                   // The padded block
+
+    // Load every register, lanes past the end read as INT_MAX
+    const __m512i padding = _mm512_set1_epi32(INT_MAX);
+    for (std::size_t index = 0; index < registers; index++) {
+        const std::size_t start = index * lanes;
+        const std::size_t valid = start < count ? count - start : 0;
+        const __mmask16 mask = valid >= lanes ? __mmask16(0xFFFF)
+                                              : __mmask16((1u << valid) - 1);
+        vectors[index] = _mm512_mask_loadu_epi32(padding, mask, data + start);
+    }
+
+    // Reverses the lanes of a register
+    const __m512i reverse = _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+                                              7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (std::size_t stage = 2; stage <= size; stage *= 2) {
+        // Mirror step of the stage
+        if (stage <= lanes) {
+            for (std::size_t index = 0; index < registers; index++) {
+                vectors[index] = exchange_avx512(vectors[index], static_cast<int>(stage - 1), true);
+            }
+        }
+        else {
+            const std::size_t span = stage / lanes;        // Registers per stage block
+            for (std::size_t index = 0; index < registers; index++) {
+                const std::size_t partner = index ^ (span - 1);
+                if (index < partner) {
+                    __m512i mirrored = _mm512_permutexvar_epi32(reverse, vectors[partner]);
+                    __m512i low = _mm512_min_epi32(vectors[index], mirrored);
+                    __m512i high = _mm512_max_epi32(vectors[index], mirrored);
+                    vectors[index] = low;
+                    vectors[partner] = _mm512_permutexvar_epi32(reverse, high);
+                }
+            }
+        }
+        // Halving steps of the stage
+        for (std::size_t distance = stage / 4; distance > 0; distance /= 2) {
+            if (distance < lanes) {
+                for (std::size_t index = 0; index < registers; index++) {
+                    vectors[index] = exchange_avx512(vectors[index], static_cast<int>(distance),
+                                                     false);
+                }
+            }
+            else {
+                const std::size_t step = distance / lanes;     // Registers apart
+                for (std::size_t index = 0; index < registers; index++) {
+                    if ((index & step) == 0) {
+                        __m512i low = _mm512_min_epi32(vectors[index], vectors[index + step]);
+                        __m512i high = _mm512_max_epi32(vectors[index], vectors[index + step]);
+                        vectors[index] = low;
+                        vectors[index + step] = high;
+                    }
+                }
+            }
+        }
+    }
+
+    // Store every register, dropping the padding
+    for (std::size_t index = 0; index < registers; index++) {
+        const std::size_t start = index * lanes;
+        const std::size_t valid = start < count ? count - start : 0;
+        const __mmask16 mask = valid >= lanes ? __mmask16(0xFFFF)
+                                              : __mmask16((1u << valid) - 1);
+        _mm512_mask_storeu_epi32(data + start, mask, vectors[index]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Compare-exchanges lanes of one AVX-512 register.
+// @param [in] vector The register.
+// @param [in] distance Lane distance, the mask XORed into a lane index.
+// @param [in] mirror Whether the distance is a mirror mask of all low bits.
+// @returns the register with the lower lane of every pair holding the min.
+// ----------------------------------------------------------------------------
+inline __m512i Simd::exchange_avx512(__m512i vector, int distance, bool mirror) {
+    // Highest bit of the distance, set in the upper lane of every pair
+    const __m512i upper = _mm512_set1_epi32(mirror ? (distance + 1) / 2 : distance);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i partners = _mm512_xor_si512(lanes, _mm512_set1_epi32(distance));
+    const __mmask16 takeMax = _mm512_test_epi32_mask(lanes, upper);
+
+    __m512i swapped = _mm512_permutexvar_epi32(partners, vector);
+    __m512i low = _mm512_min_epi32(vector, swapped);
+    __m512i high = _mm512_max_epi32(vector, swapped);
+    return _mm512_mask_blend_epi32(takeMax, low, high);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions an array around a pivot with SSE4.2 registers.
+// @param [in] data The array to partition.
+// @param [in] count Number of values in the array.
+// @param [in] pivot The value to partition around.
+// @note Same loop as the AVX2 kernel, except each step reads four registers
+// from the chosen end. The side is data dependent and often mispredicted,
+// which a single 16 byte register per choice would not pay for.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+template <class T>
+std::size_t Simd::partition_sse42(T* data, std::size_t count, T pivot) {
+    constexpr std::size_t lanes = 16 / sizeof(T);  // Values per register
+    constexpr std::size_t step = 4 * lanes;        // Values read per step
+
+    if (count < 4 * step) {
+        return partition_scalar(data, count, pivot);
+    }
+
+    T rest[3 * step];                  // First and last step, then the remainder
+    std::size_t writeLeft = 0;         // Next slot for a lower value
+    std::size_t writeRight = count;    // One past the next slot for an upper value
+    std::size_t readLeft = step;       // Next unread value from the left
+    std::size_t readRight = count - step;      // One past the last unread value
+
+    for (std::size_t lane = 0; lane < step; lane++) {
+        rest[lane] = data[lane];
+        rest[step + lane] = data[readRight + lane];
+    }
+
+    while (readRight - readLeft >= step) {
+        const bool fromLeft = readLeft - writeLeft <= writeRight - readRight;
+        const T* source = data + (fromLeft ? readLeft : readRight - step);
+        readLeft += fromLeft ? step : 0;
+        readRight -= fromLeft ? 0 : step;
+
+        // Copied out first, the stores of one register may cover the next
+        T block[step];
+        std::memcpy(block, source, sizeof(block));
+        for (std::size_t offset = 0; offset < step; offset += lanes) {
+            const std::size_t below = compress_sse42(block + offset, data + writeLeft,
+                                                     data + writeRight, pivot);
+            writeLeft += below;
+            writeRight -= lanes - below;
+        }
+    }
+
+    // Remainder shorter than a step
+    for (std::size_t index = readLeft; index < readRight; index++) {
+        rest[2 * step + index - readLeft] = data[index];
+    }
+    return partition_rest(data, writeLeft, writeRight, rest,
+                          2 * step + (readRight - readLeft), pivot);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions an array around a pivot with AVX2 registers.
+// @param [in] data The array to partition.
+// @param [in] count Number of values in the array.
+// @param [in] pivot The value to partition around.
+// @note The first and last register of values are set aside, which leaves a
+// register of free space at both ends. Each step loads the next register
+// from the end with less free space, so both ends keep at least a register
+// free, and writes its lower lanes at the left end and its upper lanes at
+// the right end. The values set aside and the remainder shorter than a
+// register fill the gap left in the middle.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+template <class T>
+std::size_t Simd::partition_avx2(T* data, std::size_t count, T pivot) {
+    constexpr std::size_t lanes = 32 / sizeof(T);  // Values per register
+
+    if (count < 4 * lanes) {
+        return partition_scalar(data, count, pivot);
+    }
+
+    T rest[3 * lanes];                 // First and last register, then the remainder
+    std::size_t writeLeft = 0;         // Next slot for a lower value
+    std::size_t writeRight = count;    // One past the next slot for an upper value
+    std::size_t readLeft = lanes;      // Next unread value from the left
+    std::size_t readRight = count - lanes;     // One past the last unread value
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        rest[lane] = data[lane];
+        rest[lanes + lane] = data[readRight + lane];
+    }
+
+    while (readRight - readLeft >= lanes) {
+        // Selected without a branch, the side depends on the data
+        const bool fromLeft = readLeft - writeLeft <= writeRight - readRight;
+        const T* source = data + (fromLeft ? readLeft : readRight - lanes);
+        readLeft += fromLeft ? lanes : 0;
+        readRight -= fromLeft ? 0 : lanes;
+        const std::size_t below = compress_avx2(source, data + writeLeft, data + writeRight,
+                                                pivot);
+        writeLeft += below;
+        writeRight -= lanes - below;
+    }
+
+    // Remainder shorter than a register
+    for (std::size_t index = readLeft; index < readRight; index++) {
+        rest[2 * lanes + index - readLeft] = data[index];
+    }
+    return partition_rest(data, writeLeft, writeRight, rest,
+                          2 * lanes + (readRight - readLeft), pivot);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions an array around a pivot with AVX-512 registers.
+// @param [in] data The array to partition.
+// @param [in] count Number of values in the array.
+// @param [in] pivot The value to partition around.
+// @note Same loop as the AVX2 kernel, with compress-stores writing only the
+// lanes that belong at each end.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+template <class T>
+std::size_t Simd::partition_avx512(T* data, std::size_t count, T pivot) {
+    constexpr std::size_t lanes = 64 / sizeof(T);  // Values per register
+
+    if (count < 4 * lanes) {
+        return partition_scalar(data, count, pivot);
+    }
+
+    T rest[3 * lanes];                 // First and last register, then the remainder
+    std::size_t writeLeft = 0;         // Next slot for a lower value
+    std::size_t writeRight = count;    // One past the next slot for an upper value
+    std::size_t readLeft = lanes;      // Next unread value from the left
+    std::size_t readRight = count - lanes;     // One past the last unread value
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        rest[lane] = data[lane];
+        rest[lanes + lane] = data[readRight + lane];
+    }
+
+    while (readRight - readLeft >= lanes) {
+        // Selected without a branch, the side depends on the data
+        const bool fromLeft = readLeft - writeLeft <= writeRight - readRight;
+        const T* source = data + (fromLeft ? readLeft : readRight - lanes);
+        readLeft += fromLeft ? lanes : 0;
+        readRight -= fromLeft ? 0 : lanes;
+        const std::size_t below = compress_avx512(source, data + writeLeft, data + writeRight,
+                                                  pivot);
+        writeLeft += below;
+        writeRight -= lanes - below;
+    }
+
+    // Remainder shorter than a register
+    for (std::size_t index = readLeft; index < readRight; index++) {
+        rest[2 * lanes + index - readLeft] = data[index];
+    }
+    return partition_rest(data, writeLeft, writeRight, rest,
+                          2 * lanes + (readRight - readLeft), pivot);
+}
+
+// ----------------------------------------------------------------------------
+// Builds the SSE4.2 byte order that moves the masked lanes to the front.
+// @param [in] mask One bit per lane, set for the lanes below the pivot.
+// @param [in] wide Whether lanes are 64 bits rather than 32.
+// @note The orders are built once into tables of shuffle controls. The
+// unmasked lanes follow in order, so they end up at the back.
+// @returns the byte indices for _mm_shuffle_epi8.
+// ----------------------------------------------------------------------------
+inline __m128i Simd::compress_bytes(unsigned mask, bool wide) {
+    struct tables {
+        alignas(16) std::uint8_t narrow[16][16];   // Orders of four 32 bit lanes
+        alignas(16) std::uint8_t wide[4][16];      // Orders of two 64 bit lanes
+
+        tables() {
+            for (unsigned bits = 0; bits < 16; bits++) {
+                pack(narrow[bits], bits, 4, 4);
+            }
+            for (unsigned bits = 0; bits < 4; bits++) {
+                pack(wide[bits], bits, 2, 8);
+            }
+        }
+        // Packs the bytes of the masked lanes, then of the others
+        static void pack(std::uint8_t* order, unsigned bits, unsigned lanes, unsigned width) {
+            unsigned slot = 0;
+            for (unsigned pass = 0; pass < 2; pass++) {
+                for (unsigned lane = 0; lane < lanes; lane++) {
+                    if (((bits >> lane) & 1) == (pass == 0 ? 1u : 0u)) {
+                        for (unsigned byte = 0; byte < width; byte++) {
+                            order[slot++] = static_cast<std::uint8_t>(lane * width + byte);
+                        }
+                    }
+                }
+            }
+        }
+    };
+    static const tables table;
+
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(wide ? table.wide[mask]
+                                                                : table.narrow[mask]));
+}
+
+// ----------------------------------------------------------------------------
+// Splits one register of ints around the pivot into both ends.
+// @param [in] source The register of values to split.
+// @param [in] left Where the values below the pivot go.
+// @param [in] right One past where the other values go.
+// @param [in] pivot The value to partition around.
+// @note The register is stored whole at both ends, the lanes that do not
+// belong there land in free space and are overwritten later.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+inline std::size_t Simd::compress_sse42(const int* source, int* left, int* right, int pivot) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    const __m128i below = _mm_cmpgt_epi32(_mm_set1_epi32(pivot), values);
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(below)));
+    const __m128i ordered = _mm_shuffle_epi8(values, compress_bytes(mask, false));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(left), ordered);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(right - 4), ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_sse42(const std::int64_t* source, std::int64_t* left,
+                                        std::int64_t* right, std::int64_t pivot) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    const __m128i below = _mm_cmpgt_epi64(_mm_set1_epi64x(pivot), values);
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(below)));
+    const __m128i ordered = _mm_shuffle_epi8(values, compress_bytes(mask, true));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(left), ordered);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(right - 2), ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_sse42(const float* source, float* left, float* right,
+                                        float pivot) {
+    const __m128 values = _mm_loadu_ps(source);
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_ps(
+        _mm_cmplt_ps(values, _mm_set1_ps(pivot))));
+    const __m128 ordered = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(values),
+                                                             compress_bytes(mask, false)));
+
+    _mm_storeu_ps(left, ordered);
+    _mm_storeu_ps(right - 4, ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_sse42(const double* source, double* left, double* right,
+                                        double pivot) {
+    const __m128d values = _mm_loadu_pd(source);
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_pd(
+        _mm_cmplt_pd(values, _mm_set1_pd(pivot))));
+    const __m128d ordered = _mm_castsi128_pd(_mm_shuffle_epi8(_mm_castpd_si128(values),
+                                                              compress_bytes(mask, true)));
+
+    _mm_storeu_pd(left, ordered);
+    _mm_storeu_pd(right - 2, ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+// ----------------------------------------------------------------------------
+// Builds the AVX2 lane order that moves the masked lanes to the front.
+// @param [in] mask One bit per lane, set for the lanes below the pivot.
+// @param [in] wide Whether lanes are 64 bits, two 32 bit lanes each.
+// @note The orders are built once into tables packing a 3 bit lane index
+// per 4 bits, then unpacked with variable shifts. The unmasked lanes follow
+// in order, so they end up at the back.
+// @returns the 32 bit lane indices for _mm256_permutevar8x32.
+// ----------------------------------------------------------------------------
+inline __m256i Simd::compress_order(unsigned mask, bool wide) {
+    struct tables {
+        std::uint32_t narrow[256];     // Orders of eight 32 bit lanes
+        std::uint32_t wide[16];        // Orders of four 64 bit lanes
+
+        tables() {
+            for (unsigned bits = 0; bits < 256; bits++) {
+                narrow[bits] = pack(bits, 8, 1);
+            }
+            for (unsigned bits = 0; bits < 16; bits++) {
+                wide[bits] = pack(bits, 4, 2);
+            }
+        }
+        // Packs the masked lanes, then the others, as 32 bit lane indices
+        static std::uint32_t pack(unsigned bits, unsigned lanes, unsigned width) {
+            std::uint32_t order = 0;
+            unsigned slot = 0;
+            for (unsigned pass = 0; pass < 2; pass++) {
+                for (unsigned lane = 0; lane < lanes; lane++) {
+                    if (((bits >> lane) & 1) == (pass == 0 ? 1u : 0u)) {
+                        for (unsigned half = 0; half < width; half++) {
+                            order |= (lane * width + half) << (4 * slot++);
+                        }
+                    }
+                }
+            }
+            return order;
+        }
+    };
+    static const tables table;
+
+    const __m256i packed = _mm256_set1_epi32(static_cast<int>(wide ? table.wide[mask]
+                                                                   : table.narrow[mask]));
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    return _mm256_and_si256(_mm256_srlv_epi32(packed, shifts), _mm256_set1_epi32(7));
+}
+
+// ----------------------------------------------------------------------------
+// Splits one register of ints around the pivot into both ends.
+// @param [in] source The register of values to split.
+// @param [in] left Where the values below the pivot go.
+// @param [in] right One past where the other values go.
+// @param [in] pivot The value to partition around.
+// @note The register is stored whole at both ends, the lanes that do not
+// belong there land in free space and are overwritten later.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+inline std::size_t Simd::compress_avx2(const int* source, int* left, int* right, int pivot) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+    const __m256i below = _mm256_cmpgt_epi32(_mm256_set1_epi32(pivot), values);
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(below)));
+    const __m256i ordered = _mm256_permutevar8x32_epi32(values, compress_order(mask, false));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(left), ordered);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(right - 8), ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_avx2(const std::int64_t* source, std::int64_t* left,
+                                       std::int64_t* right, std::int64_t pivot) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+    const __m256i below = _mm256_cmpgt_epi64(_mm256_set1_epi64x(pivot), values);
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(below)));
+    const __m256i ordered = _mm256_permutevar8x32_epi32(values, compress_order(mask, true));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(left), ordered);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(right - 4), ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_avx2(const float* source, float* left, float* right,
+                                       float pivot) {
+    const __m256 values = _mm256_loadu_ps(source);
+    const __m256 below = _mm256_cmp_ps(values, _mm256_set1_ps(pivot), _CMP_LT_OQ);
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(below));
+    const __m256 ordered = _mm256_permutevar8x32_ps(values, compress_order(mask, false));
+
+    _mm256_storeu_ps(left, ordered);
+    _mm256_storeu_ps(right - 8, ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+inline std::size_t Simd::compress_avx2(const double* source, double* left, double* right,
+                                       double pivot) {
+    const __m256d values = _mm256_loadu_pd(source);
+    const __m256d below = _mm256_cmp_pd(values, _mm256_set1_pd(pivot), _CMP_LT_OQ);
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(below));
+    const __m256d ordered = _mm256_castps_pd(_mm256_permutevar8x32_ps(
+        _mm256_castpd_ps(values), compress_order(mask, true)));
+
+    _mm256_storeu_pd(left, ordered);
+    _mm256_storeu_pd(right - 4, ordered);
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+// ----------------------------------------------------------------------------
+// Splits one register of ints around the pivot into both ends.
+// @param [in] source The register of values to split.
+// @param [in] left Where the values below the pivot go.
+// @param [in] right One past where the other values go.
+// @param [in] pivot The value to partition around.
+// @note Compress-stores write only the lanes that belong at each end.
+// @returns the number of values below the pivot.
+// ----------------------------------------------------------------------------
+inline std::size_t Simd::compress_avx512(const int* source, int* left, int* right, int pivot) {
+    const __m512i values = _mm512_loadu_si512(source);
+    const __mmask16 below = _mm512_cmplt_epi32_mask(values, _mm512_set1_epi32(pivot));
+    const std::size_t count = static_cast<std::size_t>(__builtin_popcount(below));
+
+    _mm512_mask_compressstoreu_epi32(left, below, values);
+    _mm512_mask_compressstoreu_epi32(right - (16 - count), static_cast<__mmask16>(~below),
+                                     values);
+    return count;
+}
+
+inline std::size_t Simd::compress_avx512(const std::int64_t* source, std::int64_t* left,
+                                         std::int64_t* right, std::int64_t pivot) {
+    const __m512i values = _mm512_loadu_si512(source);
+    const __mmask8 below = _mm512_cmplt_epi64_mask(values, _mm512_set1_epi64(pivot));
+    const std::size_t count = static_cast<std::size_t>(__builtin_popcount(below));
+
+    _mm512_mask_compressstoreu_epi64(left, below, values);
+    _mm512_mask_compressstoreu_epi64(right - (8 - count), static_cast<__mmask8>(~below),
+                                     values);
+    return count;
+}
+
+inline std::size_t Simd::compress_avx512(const float* source, float* left, float* right,
+                                         float pivot) {
+    const __m512 values = _mm512_loadu_ps(source);
+    const __mmask16 below = _mm512_cmp_ps_mask(values, _mm512_set1_ps(pivot), _CMP_LT_OQ);
+    const std::size_t count = static_cast<std::size_t>(__builtin_popcount(below));
+
+    _mm512_mask_compressstoreu_ps(left, below, values);
+    _mm512_mask_compressstoreu_ps(right - (16 - count), static_cast<__mmask16>(~below),
+                                  values);
+    return count;
+}
+
+inline std::size_t Simd::compress_avx512(const double* source, double* left, double* right,
+                                         double pivot) {
+    const __m512d values = _mm512_loadu_pd(source);
+    const __mmask8 below = _mm512_cmp_pd_mask(values, _mm512_set1_pd(pivot), _CMP_LT_OQ);
+    const std::size_t count = static_cast<std::size_t>(__builtin_popcount(below));
+
+    _mm512_mask_compressstoreu_pd(left, below, values);
+    _mm512_mask_compressstoreu_pd(right - (8 - count), static_cast<__mmask8>(~below),
+                                  values);
+    return count;
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+#endif  /* SIMD_H_ */
@@ -1,150 +1,788 @@
 /// @file: Sort.h
-/// @author: Sao Thao 
+/// @author: Sao Thao
 /// @date: 2022-31-08
 /// @note: This class implements the analysis of common sorting
 /// algorithms such as bubble sort, insertion sort, slection sort
 /// merge sort, and quick sort.
+/// @note: Every algorithm is a template over a random access iterator,
+/// a comparator and a key projection, so any element type can be sorted
+/// in place without first copying it into a std::vector<int>.
 
 #ifndef SORT_H_
 #define SORT_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "LoserTree.h"
+#include "Simd.h"
+#include "Span.h"
+#include "ThreadPool.h"
+
+template <class T, class Less>
+class MergeFunnel;
+
 /// ----------------------------------------------------------------------------
 ///                             Sort Class
 /// ----------------------------------------------------------------------------
 class Sort {
+	// The funnel's nodes merge through the branch-free merge kernel
+	template <class T, class Less>
+	friend class MergeFunnel;
+
+	// Return type of the shared pool overloads, which drop out of overload
+	// resolution when a thread pool is passed in the comparator position
+	template <class Compare, class Result>
+	using unless_pool = typename std::enable_if<
+		!std::is_same<typename std::decay<Compare>::type, ThreadPool>::value, Result>::type;
+
 public:
+	// Default projection, hands back the element itself as the sort key.
+	struct identity {
+		template <class T>
+		constexpr T&& operator()(T&& value) const noexcept {
+			return std::forward<T>(value);
+		}
+	};
+
+	// Partitioning schemes available to intro sort
+	enum class Partition {
+		automatic,      // Three-way on many duplicates, else block for arithmetic keys
+		                // and Hoare for the rest
+		hoare,          // Two-way Hoare partition
+		three_way,      // Bentley-McIlroy partition, equal keys are never revisited
+		block,          // Branch-free BlockQuicksort partition
+		simd,           // Vectorized partition of contiguous int, int64, float and
+		                // double keys, block partition for the rest
+	};
+
 	// Bubble sort method
-	static void bubble_sort(std::vector<int>& vector);
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void bubble_sort(RandomIt first, RandomIt last,
+	                        Compare comp = Compare(), Projection proj = Projection());
 	// Selection sort method
-	static void selection_sort(std::vector<int>& vector);
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void selection_sort(RandomIt first, RandomIt last,
+	                           Compare comp = Compare(), Projection proj = Projection());
 	// Insertion sort method
-	static void insertion_sort(std::vector<int>& vector);
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void insertion_sort(RandomIt first, RandomIt last,
+	                           Compare comp = Compare(), Projection proj = Projection());
 	// Merge sort method
-	static void merge_sort(std::vector<int>& vector, int first, int last);
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void merge_sort(RandomIt first, RandomIt last,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Merge sort method reusing a caller supplied scratch arena
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void merge_sort(RandomIt first, RandomIt last,
+	                       std::vector<typename std::iterator_traits<RandomIt>::value_type>& arena,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Bottom-up (iterative) merge sort method
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void merge_sort_bottom_up(RandomIt first, RandomIt last,
+	                                 Compare comp = Compare(), Projection proj = Projection());
+	// Bottom-up merge sort method merging k runs per pass, returns its passes over memory
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static std::size_t multiway_merge_sort(RandomIt first, RandomIt last, std::size_t ways,
+	                                       Compare comp = Compare(),
+	                                       Projection proj = Projection());
+	// Cache-aware merge sort method, L2-sized tiles merged k at a time through a funnel
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void tiled_merge_sort(RandomIt first, RandomIt last,
+	                             Compare comp = Compare(), Projection proj = Projection());
+	// Merges already sorted runs into one sorted output, ties keep run order
+	template <class T, class OutputIt, class Compare = std::less<>, class Projection = identity>
+	static OutputIt kway_merge(const std::vector<Span<T>>& runs, OutputIt out,
+	                           Compare comp = Compare(), Projection proj = Projection());
+	// Parallel k-way merge of sorted runs on the shared thread pool
+	template <class T, class OutputIt, class Compare = std::less<>, class Projection = identity>
+	static unless_pool<Compare, OutputIt> parallel_kway_merge(
+	        const std::vector<Span<T>>& runs, OutputIt out,
+	        Compare comp = Compare(), Projection proj = Projection());
+	// Parallel k-way merge of sorted runs on a given thread pool
+	template <class T, class OutputIt, class Compare = std::less<>, class Projection = identity>
+	static OutputIt parallel_kway_merge(const std::vector<Span<T>>& runs, OutputIt out,
+	                                    ThreadPool& pool, Compare comp = Compare(),
+	                                    Projection proj = Projection());
+	// Adaptive natural run merge sort method (TimSort), near linear on presorted input
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void tim_sort(RandomIt first, RandomIt last,
+	                     Compare comp = Compare(), Projection proj = Projection());
 	// Quick sort method
-	static void quick_sort(std::vector<int>& vector, int first, int last);
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void quick_sort(RandomIt first, RandomIt last,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Introspective quick sort method, O(N log N) worst case
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void intro_sort(RandomIt first, RandomIt last,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Intro sort method with an explicit partitioning scheme
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void intro_sort(RandomIt first, RandomIt last, Partition scheme,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Pattern-defeating quick sort method
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void pdq_sort(RandomIt first, RandomIt last,
+	                     Compare comp = Compare(), Projection proj = Projection());
+	// Parallel merge sort method on the shared thread pool
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static unless_pool<Compare, void> parallel_merge_sort(RandomIt first, RandomIt last,
+	                                                      Compare comp = Compare(),
+	                                                      Projection proj = Projection());
+	// Parallel merge sort method on a given thread pool
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void parallel_merge_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+	                                Compare comp = Compare(), Projection proj = Projection());
+	// Work-stealing parallel quick sort method on the shared thread pool
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static unless_pool<Compare, std::vector<std::size_t>> parallel_quick_sort(
+	        RandomIt first, RandomIt last, Compare comp = Compare(), Projection proj = Projection());
+	// Work-stealing parallel quick sort method on a given pool and grain size
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static std::vector<std::size_t> parallel_quick_sort(RandomIt first, RandomIt last,
+	                                                    ThreadPool& pool, std::size_t grain,
+	                                                    Compare comp = Compare(),
+	                                                    Projection proj = Projection());
+	// Parallel sample sort method on the shared thread pool
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static unless_pool<Compare, void> parallel_sample_sort(RandomIt first, RandomIt last,
+	                                                       Compare comp = Compare(),
+	                                                       Projection proj = Projection());
+	// Parallel sample sort method on a given thread pool
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void parallel_sample_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+	                                 Compare comp = Compare(), Projection proj = Projection());
+	// Small range sort method, sorting networks for ints in their natural order
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void small_sort(RandomIt first, RandomIt last,
+	                       Compare comp = Compare(), Projection proj = Projection());
+	// Heap sort method
+	template <class RandomIt, class Compare = std::less<>, class Projection = identity>
+	static void heap_sort(RandomIt first, RandomIt last,
+	                      Compare comp = Compare(), Projection proj = Projection());
+	// LSD radix sort method for elements with an integral key
+	template <class RandomIt, class Projection = identity>
+	static void radix_sort(RandomIt first, RandomIt last, Projection proj = Projection());
+	// In place MSD radix (American flag) sort method for elements with an integral key
+	template <class RandomIt, class Projection = identity>
+	static void msd_radix_sort(RandomIt first, RandomIt last, Projection proj = Projection());
+	// MSD radix sort method for keys already equal down to the digit at a shift
+	template <class RandomIt, class Projection = identity>
+	static void msd_radix_sort(RandomIt first, RandomIt last, int shift,
+	                           Projection proj = Projection());
+	// One level of in place radix sort on the highest differing key byte,
+	// returns the shift of that byte or -1 if every key is equal
+	template <class RandomIt, class Projection = identity>
+	static int msd_radix_partition(RandomIt first, RandomIt last, std::vector<std::size_t>& bounds,
+	                               Projection proj = Projection());
+	// Parallel LSD radix sort method on the shared thread pool
+	template <class RandomIt, class Projection = identity>
+	static unless_pool<Projection, void> parallel_radix_sort(RandomIt first, RandomIt last,
+	                                                         Projection proj = Projection());
+	// Parallel LSD radix sort method on a given thread pool
+	template <class RandomIt, class Projection = identity>
+	static void parallel_radix_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+	                                Projection proj = Projection());
 
 private:
+	// Assumed per-core L2 cache size used to size cache-resident blocks
+	static constexpr std::size_t L2_CACHE_BYTES = 256 * 1024;
+	// Assumed cache line size, the unit write-combining buffers are flushed in
+	static constexpr std::size_t CACHE_LINE_BYTES = 64;
+	// Length of the insertion sorted runs bottom-up merge sort starts from
+	static constexpr std::ptrdiff_t BASE_RUN = 16;
+	// Partitions at most this long are finished with insertion sort
+	static constexpr std::ptrdiff_t INSERTION_CUTOFF = 16;
+	// Partitions at most this long are finished with a sorting network
+	static constexpr std::ptrdiff_t NETWORK_CUTOFF = 64;
+	// Partitions longer than this pick the pivot as a ninther
+	static constexpr std::ptrdiff_t NINTHER_THRESHOLD = 128;
+	// Elements sampled when looking for duplicate-heavy inputs
+	static constexpr std::ptrdiff_t DUPLICATE_SAMPLE = 64;
+	// Elements classified at a time by block partitioning, at most 256
+	static constexpr std::ptrdiff_t PARTITION_BLOCK = 64;
+	// Elements partial insertion sort may move before giving up
+	static constexpr std::ptrdiff_t PARTIAL_INSERTION_LIMIT = 8;
+	// Largest fan-in of tiled merge sort, and the fewest elements each of its
+	// funnel buffers may hold before the fan-in is lowered
+	static constexpr std::size_t TILED_FAN_IN = 8;
+	static constexpr std::size_t TILED_MIN_BUFFER = 256;
+	// Ranges shorter than this are one binary insertion sorted run of TimSort
+	static constexpr std::ptrdiff_t TIM_MIN_MERGE = 64;
+	// Wins in a row by one run after which a TimSort merge starts galloping
+	static constexpr std::ptrdiff_t MIN_GALLOP = 7;
+	// Ranges shorter than this are sorted on the calling thread
+	static constexpr std::ptrdiff_t PARALLEL_CUTOFF = 1 << 14;
+	// Sample keys drawn per bucket when sample sort picks its splitters
+	static constexpr std::ptrdiff_t SAMPLE_OVERSAMPLING = 64;
+	// Elements whose splitter tree walks sample sort interleaves
+	static constexpr std::ptrdiff_t SAMPLE_UNROLL = 8;
+	// Key bits sorted by one radix sort pass, and the buckets per pass. Eleven
+	// bits take three passes over 32-bit keys, and the counts stay in L2.
+	static constexpr int RADIX_BITS = 11;
+	static constexpr std::size_t RADIX_SIZE = std::size_t(1) << RADIX_BITS;
+	// Key bits split on by one level of in place radix sort, and its buckets
+	static constexpr int MSD_RADIX_BITS = 8;
+	static constexpr std::size_t MSD_RADIX_SIZE = std::size_t(1) << MSD_RADIX_BITS;
+	// Buckets at most this long are finished with a comparison sort
+	static constexpr std::ptrdiff_t MSD_RADIX_CUTOFF = 128;
+
+	// Comparator applied to the projected keys of two elements
+	template <class Compare, class Projection>
+	struct projected {
+		Compare comp;
+		Projection proj;
+
+		template <class A, class B>
+		bool operator()(A&& a, B&& b) const {
+			return comp(proj(std::forward<A>(a)), proj(std::forward<B>(b)));
+		}
+	};
+
+	// Whether the sorting networks can sort a range, contiguous ints compared
+	// in their natural order
+	template <class RandomIt, class Less>
+	using network_sortable = std::integral_constant<bool,
+		(std::is_same<RandomIt, int*>::value
+		 || std::is_same<RandomIt, std::vector<int>::iterator>::value)
+		&& (std::is_same<Less, projected<std::less<>, identity>>::value
+		    || std::is_same<Less, projected<std::less<int>, identity>>::value)>;
+
+	// Whether the vector partition kernels can partition a range, contiguous
+	// int, int64, float or double compared in their natural order
+	template <class RandomIt, class Less,
+	          class T = typename std::iterator_traits<RandomIt>::value_type>
+	using simd_partitionable = std::integral_constant<bool,
+		(std::is_same<T, int>::value || std::is_same<T, std::int64_t>::value
+		 || std::is_same<T, float>::value || std::is_same<T, double>::value)
+		&& (std::is_same<RandomIt, T*>::value
+		    || std::is_same<RandomIt, typename std::vector<T>::iterator>::value)
+		&& (std::is_same<Less, projected<std::less<>, identity>>::value
+		    || std::is_same<Less, projected<std::less<T>, identity>>::value)>;
+
+	// Whether merge can pick elements without branching, random access lists
+	// and output of one trivially copyable type
+	template <class InputIt1, class InputIt2, class OutputIt,
+	          class T = typename std::iterator_traits<InputIt1>::value_type>
+	using branchless_mergeable = std::integral_constant<bool,
+		std::is_trivially_copyable<T>::value
+		&& std::is_same<T, typename std::iterator_traits<InputIt2>::value_type>::value
+		&& std::is_base_of<std::random_access_iterator_tag,
+		                   typename std::iterator_traits<InputIt1>::iterator_category>::value
+		&& std::is_base_of<std::random_access_iterator_tag,
+		                   typename std::iterator_traits<InputIt2>::iterator_category>::value
+		&& std::is_base_of<std::random_access_iterator_tag,
+		                   typename std::iterator_traits<OutputIt>::iterator_category>::value>;
+
+	// Whether tiled merge sort can merge through a funnel, contiguous
+	// trivially copyable elements
+	template <class RandomIt, class T = typename std::iterator_traits<RandomIt>::value_type>
+	using funnel_mergeable = std::integral_constant<bool,
+		std::is_trivially_copyable<T>::value
+		&& (std::is_same<RandomIt, T*>::value
+		    || std::is_same<RandomIt, typename std::vector<T>::iterator>::value)>;
+
+	// Length up to which a range is finished by small_sort_loop
+	template <class RandomIt, class Less>
+	static constexpr std::ptrdiff_t small_sort_cutoff() {
+		return network_sortable<RandomIt, Less>::value ? NETWORK_CUTOFF : INSERTION_CUTOFF;
+	}
+
+	// Builds the projected comparator used by every algorithm
+	template <class Compare, class Projection>
+	static projected<Compare, Projection> make_less(Compare comp, Projection proj);
+	// Recursive in place portion of merge sort
+	template <class RandomIt, class BufferIt, class Less>
+	static void merge_sort_loop(RandomIt first, RandomIt last, BufferIt buffer, Less& less);
+	// Recursive out of place portion of merge sort
+	template <class RandomIt, class OutputIt, class Less>
+	static void merge_sort_into(RandomIt first, RandomIt last, OutputIt out, Less& less);
+	// Insertion sort of a range with the projected comparator
+	template <class RandomIt, class Less>
+	static void insertion_sort_loop(RandomIt first, RandomIt last, Less& less);
+	// Sorts a short range with the fastest kernel available for it
+	template <class RandomIt, class Less>
+	static void small_sort_loop(RandomIt first, RandomIt last, Less& less);
+	// Small range kernel for ranges the sorting networks cannot sort
+	template <class RandomIt, class Less>
+	static void small_sort_loop(RandomIt first, RandomIt last, Less& less, std::false_type);
+	// Small range kernel handing contiguous ints to the sorting networks
+	template <class RandomIt, class Less>
+	static void small_sort_loop(RandomIt first, RandomIt last, Less& less, std::true_type);
+	// Sorts the cache-sized blocks of a range on whichever side holds them,
+	// returns the block length
+	template <class RandomIt, class Less>
+	static std::ptrdiff_t merge_sort_blocks(
+		RandomIt first, RandomIt last, typename std::iterator_traits<RandomIt>::value_type* buffer,
+		bool inBuffer, Less& less);
+	// Sorts one cache-resident block for bottom-up merge sort
+	template <class RandomIt, class BufferIt, class Less>
+	static void merge_sort_block(RandomIt first, RandomIt last, BufferIt buffer,
+	                             std::ptrdiff_t run, Less& less);
+	// Bottom-up merge sort merging k runs per pass, returns its passes over memory
+	template <class RandomIt, class Less, bool Funnel>
+	static std::size_t multiway_merge_loop(RandomIt first, RandomIt last, std::size_t ways,
+	                                       Less& less, std::integral_constant<bool, Funnel> funnel);
+	// Merges every pair of neighbouring runs of one width into the output
+	template <class InputIt, class OutputIt, class Less>
+	static void merge_pass(InputIt first, std::ptrdiff_t size, std::ptrdiff_t width,
+	                       OutputIt out, Less& less);
+	// Merges every group of k neighbouring runs of one width into the output
+	template <class InputIt, class OutputIt, class Less>
+	static void multiway_merge_pass(InputIt first, std::ptrdiff_t size, std::ptrdiff_t width,
+	                                std::size_t ways, OutputIt out, Less& less);
+	// Fan-in of tiled merge sort, as many runs as funnel buffers fit in L2
+	static constexpr std::size_t tiled_fan_in(std::size_t elementBytes);
+	// Multiway merge sort pass between range and buffer through loser trees
+	template <class RandomIt, class Less>
+	static void multiway_merge_pass(RandomIt first, RandomIt last,
+	                                typename std::iterator_traits<RandomIt>::value_type* buffer,
+	                                bool toBuffer, std::ptrdiff_t width, std::size_t ways,
+	                                Less& less, std::false_type);
+	// Multiway merge sort pass between range and buffer through a funnel of
+	// branch-free two-way merges
+	template <class RandomIt, class Less>
+	static void multiway_merge_pass(RandomIt first, RandomIt last,
+	                                typename std::iterator_traits<RandomIt>::value_type* buffer,
+	                                bool toBuffer, std::ptrdiff_t width, std::size_t ways,
+	                                Less& less, std::true_type);
+	// Length TimSort extends short natural runs to
+	static std::ptrdiff_t tim_min_run(std::ptrdiff_t size);
+	// Finds the natural run at the front of a range, reversing a descending one
+	template <class RandomIt, class Less>
+	static RandomIt tim_count_run(RandomIt first, RandomIt last, Less& less);
+	// Binary insertion sort of a range whose front is already sorted
+	template <class RandomIt, class Less>
+	static void binary_insertion_sort(RandomIt first, RandomIt sorted, RandomIt last,
+	                                  Less& less);
+	// Merges pending TimSort runs until the run stack invariants hold again
+	template <class RandomIt, class Buffer, class Less>
+	static void tim_collapse(RandomIt first,
+	                         std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>>& runs,
+	                         bool force, Buffer& buffer, std::ptrdiff_t& minGallop, Less& less);
+	// Merges the pending TimSort run at an index with the one after it
+	template <class RandomIt, class Buffer, class Less>
+	static void tim_merge_at(RandomIt first,
+	                         std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>>& runs,
+	                         std::size_t index, Buffer& buffer, std::ptrdiff_t& minGallop,
+	                         Less& less);
+	// Merges two neighbouring runs front to back, the left one the shorter
+	template <class RandomIt, class Buffer, class Less>
+	static void tim_merge_low(RandomIt base1, std::ptrdiff_t size1, RandomIt base2,
+	                          std::ptrdiff_t size2, Buffer& buffer, std::ptrdiff_t& minGallop,
+	                          Less& less);
+	// Merges two neighbouring runs back to front, the right one the shorter
+	template <class RandomIt, class Buffer, class Less>
+	static void tim_merge_high(RandomIt base1, std::ptrdiff_t size1, RandomIt base2,
+	                           std::ptrdiff_t size2, Buffer& buffer, std::ptrdiff_t& minGallop,
+	                           Less& less);
+	// Leftmost position of a key in a sorted run, searched outwards from a hint
+	template <class T, class InputIt, class Less>
+	static std::ptrdiff_t gallop_left(const T& key, InputIt base, std::ptrdiff_t size,
+	                                  std::ptrdiff_t hint, Less& less);
+	// Rightmost position of a key in a sorted run, searched outwards from a hint
+	template <class T, class InputIt, class Less>
+	static std::ptrdiff_t gallop_right(const T& key, InputIt base, std::ptrdiff_t size,
+	                                   std::ptrdiff_t hint, Less& less);
+	// Recursive portion of quick sort
+	template <class RandomIt, class Less>
+	static void quick_sort_loop(RandomIt first, RandomIt last, Less& less);
 	// Partition portion of quick sort
-	static int partition(std::vector<int>& vector, int first, int last, int pivot);
+	template <class RandomIt, class Less>
+	static RandomIt partition(RandomIt first, RandomIt last, RandomIt pivot, Less& less);
+	// Loop portion of intro sort
+	template <class RandomIt, class Less>
+	static void intro_sort_loop(RandomIt first, RandomIt last, int depth,
+	                            Partition scheme, bool leftmost, Less& less);
+	// Resolves the automatic partitioning scheme for a range
+	template <class RandomIt, class Less>
+	static Partition resolve_partition(RandomIt first, RandomIt last, Partition scheme,
+	                                   bool arithmetic, Less& less);
+	// Picks a pivot and partitions a range around it with the given scheme
+	template <class RandomIt, class Less>
+	static std::pair<RandomIt, RandomIt> intro_partition(RandomIt first, RandomIt last,
+	                                                     Partition scheme, bool leftmost,
+	                                                     Less& less);
+	// Samples a range to decide whether it holds many equal keys
+	template <class RandomIt, class Less>
+	static bool many_duplicates(RandomIt first, RandomIt last, Less& less);
+	// Moves the median-of-three or ninther pivot to the front of a range
+	template <class RandomIt, class Less>
+	static void choose_pivot(RandomIt first, RandomIt last, Less& less);
+	// Orders three elements in place
+	template <class RandomIt, class Less>
+	static void sort3(RandomIt a, RandomIt b, RandomIt c, Less& less);
+	// Hoare partition around the pivot held at the front of a range
+	template <class RandomIt, class Less>
+	static RandomIt partition_hoare(RandomIt first, RandomIt last, Less& less);
+	// Three-way partition around the pivot held at the front of a range
+	template <class RandomIt, class Less>
+	static std::pair<RandomIt, RandomIt> partition_three_way(RandomIt first, RandomIt last,
+	                                                         Less& less);
+	// Branch-free block partition around the pivot held at the front of a range
+	template <class RandomIt, class Less>
+	static RandomIt partition_block(RandomIt first, RandomIt last, Less& less);
+	// Vector partition around the pivot held at the front of a range
+	template <class RandomIt, class Less>
+	static RandomIt partition_simd(RandomIt first, RandomIt last, Less& less);
+	// Partition fallback for ranges the vector kernels cannot partition
+	template <class RandomIt, class Less>
+	static RandomIt partition_simd(RandomIt first, RandomIt last, Less& less, std::false_type);
+	// Partition handing contiguous keys to the vector kernels
+	template <class RandomIt, class Less>
+	static RandomIt partition_simd(RandomIt first, RandomIt last, Less& less, std::true_type);
+	// Block partitions the elements between two scans against a pivot
+	template <class RandomIt, class Less>
+	static RandomIt partition_block_range(RandomIt pivot, RandomIt leftIndex,
+	                                      RandomIt rightIndex, Less& less);
+	// Loop portion of pattern-defeating quick sort
+	template <class RandomIt, class Less>
+	static void pdq_sort_loop(RandomIt first, RandomIt last, int badAllowed,
+	                          bool block, bool leftmost, Less& less);
+	// Partition keeping equal keys right, reporting already partitioned input
+	template <class RandomIt, class Less>
+	static RandomIt partition_right(RandomIt first, RandomIt last, bool block,
+	                                bool& alreadyPartitioned, Less& less);
+	// Partition keeping equal keys left, used when the pivot repeats
+	template <class RandomIt, class Less>
+	static RandomIt partition_left(RandomIt first, RandomIt last, Less& less);
+	// Insertion sort that gives up once too many elements move
+	template <class RandomIt, class Less>
+	static bool partial_insertion_sort(RandomIt first, RandomIt last, Less& less);
+	// Swaps elements into a range's head and tail to break up patterns
+	template <class RandomIt>
+	static void break_patterns(RandomIt first, RandomIt last);
+	// Swaps misplaced elements found by block partitioning in one cycle
+	template <class RandomIt>
+	static void swap_offsets(RandomIt left, RandomIt right, const unsigned char* offsetsLeft,
+	                         const unsigned char* offsetsRight, std::ptrdiff_t count);
+	// Heap sort of a range with the projected comparator
+	template <class RandomIt, class Less>
+	static void heap_sort_loop(RandomIt first, RandomIt last, Less& less);
+	// Restores the max-heap property below a hole
+	template <class RandomIt, class Less>
+	static void sift_down(RandomIt first, std::ptrdiff_t hole, std::ptrdiff_t size, Less& less);
+	// Integer base two logarithm, rounded down
+	static int log2_floor(std::size_t value);
+	// Scratch room as long as a range, left uninitialized for trivial elements
+	template <class RandomIt>
+	static std::unique_ptr<typename std::iterator_traits<RandomIt>::value_type[]>
+	scratch_buffer(RandomIt first, RandomIt last, std::true_type);
+	// Scratch room as long as a range, other elements are moved into it
+	template <class RandomIt>
+	static std::vector<typename std::iterator_traits<RandomIt>::value_type>
+	scratch_buffer(RandomIt first, RandomIt last, std::false_type);
 	// Merging portion of merge sort
-	static void merge(std::vector<int>& vector, int first, int split, int last);
+	template <class InputIt1, class InputIt2, class OutputIt, class Less>
+	static OutputIt merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+	                      OutputIt out, Less& less);
+	// Merge that branches on every comparison, for elements costly to copy
+	template <class InputIt1, class InputIt2, class OutputIt, class Less>
+	static OutputIt merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+	                      OutputIt out, Less& less, std::false_type);
+	// Merge from both ends at once without branching, for trivially copyable elements
+	template <class InputIt1, class InputIt2, class OutputIt, class Less>
+	static OutputIt merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+	                      OutputIt out, Less& less, std::true_type);
+	// Front to back merge selecting each element with a conditional move
+	template <class InputIt1, class InputIt2, class OutputIt, class Less>
+	static OutputIt merge_branchless(InputIt1 first1, InputIt1 last1, InputIt2 first2,
+	                                 InputIt2 last2, OutputIt out, Less& less);
+	// Finds how many left elements precede a rank of two merged lists
+	template <class InputIt, class Less>
+	static std::ptrdiff_t co_rank(std::ptrdiff_t rank, InputIt left, std::ptrdiff_t leftSize,
+	                              InputIt right, std::ptrdiff_t rightSize, Less& less);
+	// Finds how many elements of every run precede a rank of k merged runs
+	template <class T, class Less>
+	static void multi_co_rank(std::ptrdiff_t rank, const std::vector<std::pair<T*, T*>>& runs,
+	                          std::vector<std::ptrdiff_t>& splits, Less& less);
+	// Merges sorted runs given as pointer ranges, two runs without branches
+	template <class T, class OutputIt, class Less>
+	static OutputIt kway_merge_loop(std::vector<std::pair<T*, T*>>& runs, OutputIt out,
+	                                Less& less);
+	// Finds the sample sort bucket of every element and counts each bucket
+	template <class InputIt, class Key, class Less>
+	static void sample_classify(InputIt first, InputIt last, const Key* tree, int levels,
+	                            const Key* upper, std::uint16_t* oracle, std::size_t* counts,
+	                            Less& less);
+	// Merges neighbouring pairs of sorted runs with every worker of a pool
+	template <class InputIt, class OutputIt, class Less>
+	static void parallel_merge_pass(InputIt first, OutputIt out,
+	                                std::vector<std::ptrdiff_t>& bounds,
+	                                ThreadPool& pool, Less& less);
+	// Maps an integral key to an unsigned key with the same ordering
+	template <class Key>
+	static typename std::make_unsigned<Key>::type radix_key(Key key);
+	// Moves elements into their buckets by one digit of the radix key
+	template <class InputIt, class OutputIt, class Projection>
+	static void radix_scatter(InputIt first, InputIt last, OutputIt out, int shift,
+	                          std::size_t* offsets, Projection& proj);
+	// Counts the elements falling in each bucket for one digit of the radix key
+	template <class InputIt, class Projection>
+	static void radix_count(InputIt first, InputIt last, int shift, std::size_t* counts,
+	                        Projection& proj);
+	// Radix scatter of elements that cannot be staged, writes them directly
+	template <class InputIt, class OutputIt, class Projection, class Staged>
+	static void radix_scatter_combined(InputIt first, InputIt last, OutputIt out, int shift,
+	                                   std::size_t* offsets, Projection& proj, Staged* staging,
+	                                   std::false_type);
+	// Radix scatter staging every bucket in a cache line sized buffer
+	template <class InputIt, class OutputIt, class Projection, class Staged>
+	static void radix_scatter_combined(InputIt first, InputIt last, OutputIt out, int shift,
+	                                   std::size_t* offsets, Projection& proj, Staged* staging,
+	                                   std::true_type);
+	// Recursive portion of in place radix sort
+	template <class RandomIt, class Less>
+	static void msd_radix_loop(RandomIt first, RandomIt last, int shift, Less& less);
+	// Permutes a range into buckets by its highest differing digit at or below
+	// shift, returns that digit's shift or -1 if every key is equal
+	template <class RandomIt, class Less>
+	static int msd_radix_split(RandomIt first, RandomIt last, int shift, std::size_t* counts,
+	                           Less& less);
 };
 
+// Defines the funnel, which needs the complete Sort class
+#include "MergeFunnel.h"
+
+// ----------------------------------------------------------------------------
+// Bundles a comparator and a projection into a single element comparator.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @returns the comparator used by the sorting algorithms.
+// ----------------------------------------------------------------------------
+template <class Compare, class Projection>
+Sort::projected<Compare, Projection> Sort::make_less(Compare comp, Projection proj) {
+    return projected<Compare, Projection>{std::move(comp), std::move(proj)};
+}
+
 // ----------------------------------------------------------------------------
-// Sorts a vector using the bubble sort algorithm.
-// @param [in] vector The vector to sort.
+// Sorts a range using the bubble sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
 // ----------------------------------------------------------------------------
-void Sort::bubble_sort(std::vector<int>& vector) {
-    // Iterate through the vector.
-    for (int current = 0; current < vector.size(); current++) {
-        for (int iterator = current; iterator < vector.size(); iterator++) {
+template <class RandomIt, class Compare, class Projection>
+void Sort::bubble_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    // Iterate through the range.
+    for (RandomIt current = first; current < last; ++current) {
+        for (RandomIt iterator = current; iterator < last; ++iterator) {
             // If the current element is greater than the iterating position.
-            if (vector[current] > vector[iterator]) {
-                std::swap(vector[iterator], vector[current]);
+            if (less(*iterator, *current)) {
+                std::iter_swap(iterator, current);
             }
         }
     }
 }
 
 // ----------------------------------------------------------------------------
-// Sorts a vector using the selection sort algorithm.
-// @param [in] vector The vector to sort.
+// Sorts a range using the selection sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
 // ----------------------------------------------------------------------------
-void Sort::selection_sort(std::vector<int>& vector) {
-    // Iterate through the vector.
-    for (int index = 0; index < vector.size(); index++) {
-        // Selected index.
-        int selected = index;
+template <class RandomIt, class Compare, class Projection>
+void Sort::selection_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
 
-        for (int iterator = index; iterator < vector.size(); iterator++) {
+    // Iterate through the range.
+    for (RandomIt index = first; index < last; ++index) {
+        // Selected position.
+        RandomIt selected = index;
+
+        for (RandomIt iterator = index; iterator < last; ++iterator) {
             // Smaller value found
-            if (vector[selected] > vector[iterator]) {
-                // Reassign selected index to smaller value
+            if (less(*iterator, *selected)) {
+                // Reassign selected position to smaller value
                 selected = iterator;
             }
         }
         // Swap contents
-        std::swap(vector[selected], vector[index]);
+        std::iter_swap(selected, index);
     }
 }
 
 // ----------------------------------------------------------------------------
-// Sorts a vector using the insertion sort algorithm.
-// @param [in] vector The vector to sort.
+// Sorts a range using the insertion sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::insertion_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+    insertion_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Performs the insertion sort passes over a range.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
 // ----------------------------------------------------------------------------
-void Sort::insertion_sort(std::vector<int>& vector) {
-    int temp;   // Temp memory to hold smaller value.
+template <class RandomIt, class Less>
+void Sort::insertion_sort_loop(RandomIt first, RandomIt last, Less& less) {
+    if (first == last) {
+        return;
+    }
 
-    // Iterate through the vector.
-    for (int iterator = 0; iterator < vector.size(); iterator++) {
+    // Iterate through the range.
+    for (RandomIt iterator = first + 1; iterator < last; ++iterator) {
         // If the current value is smaller than the value to the left.
-        if (vector[iterator] < vector[iterator - 1]) {
-            // Store the current smaller value.
-            temp = vector[iterator];
+        if (less(*iterator, *(iterator - 1))) {
+            // Move the current smaller value out of the range.
+            auto temp = std::move(*iterator);
 
-            // Store the index of the smaller value.
-            int index = iterator;
+            // Store the position of the smaller value.
+            RandomIt index = iterator;
 
             // While at the location of the smaller value
-            // iterate the vector backwards sorting.
-            while (index > 0 && vector[index - 1] > temp) {
-                // Move the larger number to the right.
-                vector[index] = vector[index - 1];
-                // Iterate down the vector.
-                index--;
+            // iterate the range backwards sorting.
+            while (index > first && less(temp, *(index - 1))) {
+                // Move the larger value to the right.
+                *index = std::move(*(index - 1));
+                // Iterate down the range.
+                --index;
             }
             // Move smaller value to the left.
-            vector[index] = temp;
+            *index = std::move(temp);
         }
     }
 }
 
 // ----------------------------------------------------------------------------
-// Sorts a vector using the quick sort algorithm.
+// Sorts a short range using sorting networks when it holds ints compared in
+// their natural order, and insertion sort otherwise.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Ranges longer than Simd::NETWORK_MAX are sorted with pdq sort.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::small_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    if (last - first > static_cast<std::ptrdiff_t>(Simd::NETWORK_MAX)) {
+        pdq_sort(first, last, std::move(comp), std::move(proj));
+        return;
+    }
+    auto less = make_less(std::move(comp), std::move(proj));
+    small_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range no longer than Simd::NETWORK_MAX, the base case of the
+// recursive algorithms.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::small_sort_loop(RandomIt first, RandomIt last, Less& less) {
+    small_sort_loop(first, last, less, network_sortable<RandomIt, Less>());
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a short range with insertion sort, keeping equal keys in order.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::small_sort_loop(RandomIt first, RandomIt last, Less& less, std::false_type) {
+    insertion_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a short range of contiguous ints with a vectorized sorting network.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator, the natural order of int.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::small_sort_loop(RandomIt first, RandomIt last, Less&, std::true_type) {
+    if (last - first > 1) {
+        Simd::sort_network(&*first, static_cast<std::size_t>(last - first));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the quick sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::quick_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+    quick_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Recursively partitions and sorts a range for quick sort.
 // @param [in] first The beginning of the range of elements to sort.
-// @param [in] last The end of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
 // ----------------------------------------------------------------------------
-void Sort::quick_sort(std::vector<int>& vector, int first, int last) {
-    if (first < last) {
+template <class RandomIt, class Less>
+void Sort::quick_sort_loop(RandomIt first, RandomIt last, Less& less) {
+    // Small partition
+    if (last - first <= small_sort_cutoff<RandomIt, Less>()) {
+        small_sort_loop(first, last, less);
+    }
+    else {
         // Establish pivot
-        int pivot = vector[last];
+        RandomIt pivot = last - 1;
 
         // Position of partitioning
-        int position = partition(vector, first, last, pivot);
+        RandomIt position = partition(first, last, pivot, less);
 
         // Divide and sort left side from index of sorted portion.
-        quick_sort(vector, first, position - 1);
+        quick_sort_loop(first, position, less);
         // Divide and sort right side from index of sorted portion.
-        quick_sort(vector, position + 1, last);
+        quick_sort_loop(position + 1, last, less);
     }
 }
 
 // ----------------------------------------------------------------------------
 // Performs partitioning of quick sort.
 // @param [in] first The beginning of the range of elements to sort.
-// @param [in] last The end of the range of elements to sort.
-// @param [in] pivot The pivot value
-// @note Last index is always chosen as pivot.
-// @returns the index to the left of pivot.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] pivot The pivot element.
+// @param [in] less The projected comparator.
+// @note Last element is always chosen as pivot, it stays in place until the
+// final swap so it is compared through its iterator rather than copied.
+// @returns the final position of the pivot.
 // ----------------------------------------------------------------------------
-int Sort::partition(std::vector<int>& vector, int first, int last, int pivot) {
-    int leftIndex = first;      // Left index of pivot
-    int rightIndex = first;     // Right index of pivot
+template <class RandomIt, class Less>
+RandomIt Sort::partition(RandomIt first, RandomIt last, RandomIt pivot, Less& less) {
+    RandomIt leftIndex = first;      // Left index of pivot
+    RandomIt rightIndex = first;     // Right index of pivot
 
     // Process sub lists
-    while (rightIndex <= last) {
+    while (rightIndex < last) {
         // Process values larger than pivot
-        if (vector[rightIndex] > pivot) {
-            rightIndex++;
+        if (less(*pivot, *rightIndex)) {
+            ++rightIndex;
         }
         else {
             // Process values less than pivot
-            std::swap(vector[leftIndex], vector[rightIndex]);
-            leftIndex++;
-            rightIndex++;
+            std::iter_swap(leftIndex, rightIndex);
+            ++leftIndex;
+            ++rightIndex;
         }
     }
 
@@ -152,74 +790,3229 @@ int Sort::partition(std::vector<int>& vector, int first, int last, int pivot) {
 }
 
 // ----------------------------------------------------------------------------
-// Sorts a vector using the merge sort algorithm.
+// Sorts a range using the introspective sort algorithm.
 // @param [in] first The beginning of the range of elements to sort.
-// @param [in] last The end of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Quick sort with a median-of-three (ninther on large ranges) pivot,
+// recursion into the smaller side only, an insertion sort cutoff for small
+// partitions and a heap sort fallback once the recursion passes
+// 2 * log2(N) levels. The partitioning scheme is chosen automatically.
 // ----------------------------------------------------------------------------
-void Sort::merge_sort(std::vector<int>& vector, int first, int last) {
-    if (first < last) {
-        int split = (first + (last - first) / 2);     // Index to split list
+template <class RandomIt, class Compare, class Projection>
+void Sort::intro_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    intro_sort(first, last, Partition::automatic, std::move(comp), std::move(proj));
+}
 
-        // Split left side
-        merge_sort(vector, first, split);
-        // Split right side
-        merge_sort(vector, split + 1, last);
+// ----------------------------------------------------------------------------
+// Sorts a range using the introspective sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] scheme The partitioning scheme to use.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::intro_sort(RandomIt first, RandomIt last, Partition scheme,
+                      Compare comp, Projection proj) {
+    // Key type, block partitioning pays off when comparisons are cheap
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    auto less = make_less(std::move(comp), std::move(proj));
 
-        // Merge lists
-        merge(vector, first, split, last);
+    if (last - first > 1) {
+        scheme = resolve_partition(first, last, scheme,
+                                   std::is_arithmetic<key_type>::value, less);
+        intro_sort_loop(first, last, 2 * log2_floor(last - first), scheme, true, less);
     }
 }
 
 // ----------------------------------------------------------------------------
-// Performs merging of merge sort.
+// Resolves the automatic partitioning scheme for a range.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @param [in] scheme The requested scheme.
+// @param [in] arithmetic Whether the projected keys are arithmetic.
+// @param [in] less The projected comparator.
+// @returns the requested scheme, or for automatic three-way on a duplicate
+// heavy sample, block for arithmetic keys and Hoare otherwise.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+Sort::Partition Sort::resolve_partition(RandomIt first, RandomIt last, Partition scheme,
+                                        bool arithmetic, Less& less) {
+    if (scheme != Partition::automatic) {
+        return scheme;
+    }
+    if (many_duplicates(first, last, less)) {
+        return Partition::three_way;
+    }
+    return arithmetic ? Partition::block : Partition::hoare;
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range and loops on its larger side for intro sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] depth Partitioning levels left before falling back to heap sort.
+// @param [in] scheme The partitioning scheme, never automatic.
+// @param [in] leftmost Whether no element precedes the range.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::intro_sort_loop(RandomIt first, RandomIt last, int depth,
+                           Partition scheme, bool leftmost, Less& less) {
+    while (last - first > small_sort_cutoff<RandomIt, Less>()) {
+        // Too many unbalanced partitions, finish with guaranteed N log N.
+        if (depth == 0) {
+            heap_sort_loop(first, last, less);
+            return;
+        }
+        --depth;
+
+        // Partition around a pivot
+        std::pair<RandomIt, RandomIt> bounds = intro_partition(first, last, scheme,
+                                                               leftmost, less);
+        RandomIt lessEnd = bounds.first;            // End of the keys before the pivot
+        RandomIt greaterBegin = bounds.second;      // Start of the keys after the pivot
+
+        // Recurse into the smaller side and keep looping on the larger one,
+        // which bounds the stack to log2(N) frames.
+        if (lessEnd - first < last - greaterBegin) {
+            intro_sort_loop(first, lessEnd, depth, scheme, leftmost, less);
+            first = greaterBegin;
+            leftmost = false;
+        }
+        else {
+            intro_sort_loop(greaterBegin, last, depth, scheme, false, less);
+            last = lessEnd;
+        }
+    }
+
+    // Small partition
+    small_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Picks a pivot and partitions a range around it with the given scheme.
+// @param [in] first The beginning of the range, longer than INSERTION_CUTOFF.
+// @param [in] last One past the end of the range.
+// @param [in] scheme The partitioning scheme, never automatic.
+// @param [in] leftmost Whether no element precedes the range.
+// @param [in] less The projected comparator.
+// @returns the bounds of the keys equal to the pivot, or of the pivot alone.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+std::pair<RandomIt, RandomIt> Sort::intro_partition(RandomIt first, RandomIt last,
+                                                    Partition scheme, bool leftmost,
+                                                    Less& less) {
+    // Establish pivot
+    choose_pivot(first, last, less);
+
+    // Block and vector partitioning send keys equal to the pivot right.
+    // When the pivot equals the element preceding the range, which is not
+    // larger than anything in it, gather the equal keys three-way instead.
+    bool equalPivot = (scheme == Partition::block || scheme == Partition::simd) &&
+                      !leftmost && !less(*(first - 1), *first);
+
+    // Partition around pivot, three-way leaves every equal key in place.
+    if (scheme == Partition::three_way || equalPivot) {
+        return partition_three_way(first, last, less);
+    }
+
+    RandomIt position = scheme == Partition::block ? partition_block(first, last, less)
+                      : scheme == Partition::simd  ? partition_simd(first, last, less)
+                                                   : partition_hoare(first, last, less);
+    return std::make_pair(position, position + 1);
+}
+
+// ----------------------------------------------------------------------------
+// Samples a range to decide whether it holds many equal keys.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note Sorts up to DUPLICATE_SAMPLE evenly spaced elements by reference and
+// counts neighbouring equal keys, low cardinality inputs show up quickly.
+// @returns true if at least a quarter of the sample repeats a key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+bool Sort::many_duplicates(RandomIt first, RandomIt last, Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements in the range
+    const std::ptrdiff_t count = size < DUPLICATE_SAMPLE ? size : DUPLICATE_SAMPLE;
+
+    // Sample positions, ordered by the elements they refer to
+    std::vector<RandomIt> sample;
+    sample.reserve(count);
+    for (std::ptrdiff_t index = 0; index < count; index++) {
+        sample.push_back(first + index * (size / count));
+    }
+    auto byElement = [&less](RandomIt a, RandomIt b) { return less(*a, *b); };
+    insertion_sort_loop(sample.begin(), sample.end(), byElement);
+
+    // Count keys equal to their predecessor
+    std::ptrdiff_t repeats = 0;
+    for (std::ptrdiff_t index = 1; index < count; index++) {
+        if (!less(*sample[index - 1], *sample[index])) {
+            repeats++;
+        }
+    }
+
+    return repeats * 4 >= count;
+}
+
+// ----------------------------------------------------------------------------
+// Moves a pivot estimate to the front of a range.
+// @param [in] first The beginning of the range, at least three elements long.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note Uses the median of the first, middle and last elements, or Tukey's
+// ninther (median of three medians) on ranges above NINTHER_THRESHOLD.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::choose_pivot(RandomIt first, RandomIt last, Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements in the range
+    RandomIt middle = first + size / 2;            // Middle element
+
+    if (size > NINTHER_THRESHOLD) {
+        sort3(first, middle, last - 1, less);
+        sort3(first + 1, middle - 1, last - 2, less);
+        sort3(first + 2, middle + 1, last - 3, less);
+        sort3(middle - 1, middle, middle + 1, less);
+        std::iter_swap(first, middle);
+    }
+    else {
+        sort3(middle, first, last - 1, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Orders three elements so that *a <= *b <= *c.
+// @param [in] a The first element.
+// @param [in] b The second element.
+// @param [in] c The third element.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::sort3(RandomIt a, RandomIt b, RandomIt c, Less& less) {
+    if (less(*b, *a)) {
+        std::iter_swap(a, b);
+    }
+    if (less(*c, *b)) {
+        std::iter_swap(b, c);
+        if (less(*b, *a)) {
+            std::iter_swap(a, b);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Performs Hoare partitioning around the pivot at the front of a range.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note Both scans stop on elements equal to the pivot, so runs of equal
+// keys are split evenly instead of degrading to quadratic time.
+// @returns the final position of the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_hoare(RandomIt first, RandomIt last, Less& less) {
+    RandomIt leftIndex = first;      // Left scan
+    RandomIt rightIndex = last;      // Right scan
+
+    while (true) {
+        // Skip values smaller than pivot on the left
+        do {
+            ++leftIndex;
+        } while (leftIndex < last && less(*leftIndex, *first));
+        // Skip values larger than pivot on the right, the pivot stops it
+        do {
+            --rightIndex;
+        } while (less(*first, *rightIndex));
+
+        if (leftIndex >= rightIndex) {
+            break;
+        }
+        std::iter_swap(leftIndex, rightIndex);
+    }
+
+    // Move pivot between both sides
+    std::iter_swap(first, rightIndex);
+    return rightIndex;
+}
+
+// ----------------------------------------------------------------------------
+// Performs Bentley-McIlroy three-way partitioning around the pivot at the
+// front of a range.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note Keys equal to the pivot are parked at both ends while scanning and
+// swapped into the middle at the end, so they are never partitioned again.
+// @returns the bounds of the keys equal to the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+std::pair<RandomIt, RandomIt> Sort::partition_three_way(RandomIt first, RandomIt last,
+                                                        Less& less) {
+    RandomIt leftEqual = first + 1;      // End of the equal keys on the left
+    RandomIt leftIndex = first + 1;      // Left scan
+    RandomIt rightIndex = last - 1;      // Right scan
+    RandomIt rightEqual = last - 1;      // Start of the equal keys on the right, less one
+
+    while (true) {
+        // Skip values not larger than pivot, parking equal ones on the left
+        while (leftIndex <= rightIndex && !less(*first, *leftIndex)) {
+            if (!less(*leftIndex, *first)) {
+                std::iter_swap(leftEqual, leftIndex);
+                ++leftEqual;
+            }
+            ++leftIndex;
+        }
+        // Skip values not smaller than pivot, parking equal ones on the right
+        while (leftIndex <= rightIndex && !less(*rightIndex, *first)) {
+            if (!less(*first, *rightIndex)) {
+                std::iter_swap(rightIndex, rightEqual);
+                --rightEqual;
+            }
+            --rightIndex;
+        }
+
+        if (leftIndex > rightIndex) {
+            break;
+        }
+        std::iter_swap(leftIndex, rightIndex);
+        ++leftIndex;
+        --rightIndex;
+    }
+
+    // Swap the parked equal keys from both ends into the middle
+    std::ptrdiff_t leftCount = leftEqual - first;            // Equal keys on the left
+    std::ptrdiff_t lessCount = leftIndex - leftEqual;        // Keys less than pivot
+    std::ptrdiff_t greaterCount = rightEqual - rightIndex;   // Keys greater than pivot
+    std::ptrdiff_t rightCount = (last - 1) - rightEqual;     // Equal keys on the right
+
+    std::ptrdiff_t shift = leftCount < lessCount ? leftCount : lessCount;
+    std::swap_ranges(first, first + shift, leftIndex - shift);
+    shift = greaterCount < rightCount ? greaterCount : rightCount;
+    std::swap_ranges(leftIndex, leftIndex + shift, last - shift);
+
+    return std::make_pair(first + lessCount, last - greaterCount);
+}
+
+// ----------------------------------------------------------------------------
+// Performs BlockQuicksort partitioning around the pivot at the front of a
+// range.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note Comparison results are not branched on. Instead, each result bumps
+// a counter of misplaced elements whose offsets sit in a small block from
+// either end. The misplaced pairs are then swapped in one cycle, which
+// avoids the branch mispredictions of the scalar schemes on random data.
+// Keys equal to the pivot end up on its right.
+// @returns the final position of the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_block(RandomIt first, RandomIt last, Less& less) {
+    // Partition everything behind the pivot
+    RandomIt boundary = partition_block_range(first, first + 1, last, less);
+
+    // Move pivot between both sides
+    std::iter_swap(first, boundary - 1);
+    return boundary - 1;
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range around the pivot at its front with vector instructions.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @returns the final position of the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_simd(RandomIt first, RandomIt last, Less& less) {
+    return partition_simd(first, last, less, simd_partitionable<RandomIt, Less>());
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range the vector kernels cannot handle with block partition.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @returns the final position of the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_simd(RandomIt first, RandomIt last, Less& less, std::false_type) {
+    return partition_block(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions contiguous keys around the pivot at the front of a range.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator, the natural order of the keys.
+// @note Simd::partition compares a whole register of keys against the
+// broadcast pivot at a time and writes the lower and upper lanes to the two
+// ends of the range.
+// @returns the final position of the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_simd(RandomIt first, RandomIt last, Less&, std::true_type) {
+    // Partition everything behind the pivot
+    RandomIt boundary = first + 1 + Simd::partition(&*(first + 1),
+                                                    static_cast<std::size_t>(last - first - 1),
+                                                    *first);
+
+    // Move pivot between both sides
+    std::iter_swap(first, boundary - 1);
+    return boundary - 1;
+}
+
+// ----------------------------------------------------------------------------
+// Block partitions the unscanned elements of a range against a pivot.
+// @param [in] pivot The pivot element, outside the elements to partition.
+// @param [in] leftIndex Start of the elements to partition.
+// @param [in] rightIndex One past the end of the elements to partition.
+// @param [in] less The projected comparator.
+// @returns the first element not less than the pivot.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_block_range(RandomIt pivot, RandomIt leftIndex,
+                                     RandomIt rightIndex, Less& less) {
+    unsigned char offsetsLeft[PARTITION_BLOCK];     // Misplaced offsets from the left
+    unsigned char offsetsRight[PARTITION_BLOCK];    // Misplaced offsets from the right
+    std::ptrdiff_t countLeft = 0;       // Misplaced elements pending on the left
+    std::ptrdiff_t countRight = 0;      // Misplaced elements pending on the right
+    std::ptrdiff_t startLeft = 0;       // First pending left offset
+    std::ptrdiff_t startRight = 0;      // First pending right offset
+    // Classify whole blocks from both ends while more than two remain.
+    while (rightIndex - leftIndex > 2 * PARTITION_BLOCK) {
+        if (countLeft == 0) {
+            startLeft = 0;
+            for (std::ptrdiff_t offset = 0; offset < PARTITION_BLOCK; offset++) {
+                offsetsLeft[countLeft] = static_cast<unsigned char>(offset);
+                countLeft += !less(*(leftIndex + offset), *pivot);
+            }
+        }
+        if (countRight == 0) {
+            startRight = 0;
+            for (std::ptrdiff_t offset = 0; offset < PARTITION_BLOCK; offset++) {
+                offsetsRight[countRight] = static_cast<unsigned char>(offset + 1);
+                countRight += less(*(rightIndex - (offset + 1)), *pivot);
+            }
+        }
+
+        // Swap as many misplaced pairs as both blocks hold.
+        std::ptrdiff_t count = countLeft < countRight ? countLeft : countRight;
+        swap_offsets(leftIndex, rightIndex, offsetsLeft + startLeft,
+                     offsetsRight + startRight, count);
+        countLeft -= count;
+        countRight -= count;
+        startLeft += count;
+        startRight += count;
+
+        // Move past every block that is fully partitioned.
+        if (countLeft == 0) {
+            leftIndex += PARTITION_BLOCK;
+        }
+        if (countRight == 0) {
+            rightIndex -= PARTITION_BLOCK;
+        }
+    }
+
+    // Split the remaining unclassified elements between both sides, a
+    // block that still has pending offsets keeps its full size.
+    std::ptrdiff_t unknown = (rightIndex - leftIndex) -
+                             ((countLeft || countRight) ? PARTITION_BLOCK : 0);
+    std::ptrdiff_t sizeLeft;            // Final left block length
+    std::ptrdiff_t sizeRight;           // Final right block length
+    if (countRight) {
+        sizeLeft = unknown;
+        sizeRight = PARTITION_BLOCK;
+    }
+    else if (countLeft) {
+        sizeLeft = PARTITION_BLOCK;
+        sizeRight = unknown;
+    }
+    else {
+        sizeLeft = unknown / 2;
+        sizeRight = unknown - sizeLeft;
+    }
+
+    // Classify the final, possibly short, blocks.
+    if (unknown && !countLeft) {
+        startLeft = 0;
+        for (std::ptrdiff_t offset = 0; offset < sizeLeft; offset++) {
+            offsetsLeft[countLeft] = static_cast<unsigned char>(offset);
+            countLeft += !less(*(leftIndex + offset), *pivot);
+        }
+    }
+    if (unknown && !countRight) {
+        startRight = 0;
+        for (std::ptrdiff_t offset = 0; offset < sizeRight; offset++) {
+            offsetsRight[countRight] = static_cast<unsigned char>(offset + 1);
+            countRight += less(*(rightIndex - (offset + 1)), *pivot);
+        }
+    }
+
+    std::ptrdiff_t count = countLeft < countRight ? countLeft : countRight;
+    swap_offsets(leftIndex, rightIndex, offsetsLeft + startLeft,
+                 offsetsRight + startRight, count);
+    countLeft -= count;
+    countRight -= count;
+    startLeft += count;
+    startRight += count;
+
+    if (countLeft == 0) {
+        leftIndex += sizeLeft;
+    }
+    if (countRight == 0) {
+        rightIndex -= sizeRight;
+    }
+
+    // Move the leftovers of the one unfinished block across the boundary,
+    // highest offsets first so no leftover is passed over.
+    if (countLeft) {
+        while (countLeft--) {
+            std::iter_swap(leftIndex + offsetsLeft[startLeft + countLeft], --rightIndex);
+        }
+        leftIndex = rightIndex;
+    }
+    if (countRight) {
+        while (countRight--) {
+            std::iter_swap(rightIndex - offsetsRight[startRight + countRight], leftIndex);
+            ++leftIndex;
+        }
+    }
+
+    return leftIndex;
+}
+
+// ----------------------------------------------------------------------------
+// Exchanges pairs of misplaced elements found by block partitioning.
+// @param [in] left Start of the left block.
+// @param [in] right End of the right block.
+// @param [in] offsetsLeft Offsets of the misplaced elements from the left.
+// @param [in] offsetsRight Offsets of the misplaced elements from the right.
+// @param [in] count Number of pairs to exchange.
+// @note Rotates all pairs through one temporary, moving each element once.
+// ----------------------------------------------------------------------------
+template <class RandomIt>
+void Sort::swap_offsets(RandomIt left, RandomIt right, const unsigned char* offsetsLeft,
+                        const unsigned char* offsetsRight, std::ptrdiff_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    RandomIt leftIndex = left + offsetsLeft[0];
+    RandomIt rightIndex = right - offsetsRight[0];
+    auto temp = std::move(*leftIndex);
+    *leftIndex = std::move(*rightIndex);
+
+    for (std::ptrdiff_t pair = 1; pair < count; pair++) {
+        leftIndex = left + offsetsLeft[pair];
+        *rightIndex = std::move(*leftIndex);
+        rightIndex = right - offsetsRight[pair];
+        *leftIndex = std::move(*rightIndex);
+    }
+    *rightIndex = std::move(temp);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the pattern-defeating quick sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Intro sort extended to exploit and defeat input patterns:
+// partitions that needed no swaps are finished with a bounded insertion
+// sort, which makes sorted and reverse sorted input linear. Highly
+// unbalanced partitions swap a few elements around to break adversarial
+// patterns, and after log2(N) of them heap sort takes over. Repeated
+// pivots gather their equal keys in one pass.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::pdq_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    // Key type, block partitioning pays off when comparisons are cheap
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    if (last - first > 1) {
+        pdq_sort_loop(first, last, log2_floor(last - first),
+                      std::is_arithmetic<key_type>::value, true, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range and loops on its larger side for pdq sort.
 // @param [in] first The beginning of the range of elements to sort.
-// @param [in] split The middle index of the vector.
-// @param [in] last The end of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] badAllowed Unbalanced partitions left before heap sort.
+// @param [in] block Whether to use block partitioning.
+// @param [in] leftmost Whether no element precedes the range.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::pdq_sort_loop(RandomIt first, RandomIt last, int badAllowed,
+                         bool block, bool leftmost, Less& less) {
+    while (last - first > small_sort_cutoff<RandomIt, Less>()) {
+        const std::ptrdiff_t size = last - first;      // Elements in the range
+
+        // Establish pivot
+        choose_pivot(first, last, less);
+
+        // The element preceding the range is not larger than anything in it,
+        // a pivot equal to it means every equal key can be skipped at once.
+        if (!leftmost && !less(*(first - 1), *first)) {
+            first = partition_left(first, last, less) + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned = false;    // No swaps were needed
+        RandomIt position = partition_right(first, last, block, alreadyPartitioned, less);
+        const std::ptrdiff_t leftSize = position - first;
+        const std::ptrdiff_t rightSize = last - (position + 1);
+
+        if (leftSize < size / 8 || rightSize < size / 8) {
+            // Too many bad partitions, finish with guaranteed N log N.
+            if (--badAllowed == 0) {
+                heap_sort_loop(first, last, less);
+                return;
+            }
+            // Shuffle both sides so the next pivots escape the pattern.
+            break_patterns(first, position);
+            break_patterns(position + 1, last);
+        }
+        // A balanced partition that needed no swaps hints at sorted input,
+        // try to finish both sides with a bounded insertion sort.
+        else if (alreadyPartitioned && partial_insertion_sort(first, position, less) &&
+                 partial_insertion_sort(position + 1, last, less)) {
+            return;
+        }
+
+        // Recurse into the smaller side and keep looping on the larger one.
+        if (leftSize < rightSize) {
+            pdq_sort_loop(first, position, badAllowed, block, leftmost, less);
+            first = position + 1;
+            leftmost = false;
+        }
+        else {
+            pdq_sort_loop(position + 1, last, badAllowed, block, false, less);
+            last = position;
+        }
+    }
+
+    // Small partition
+    small_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range around the pivot at its front, equal keys going right.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] block Whether to use block partitioning past the first scans.
+// @param [out] alreadyPartitioned Set when no element had to be swapped.
+// @param [in] less The projected comparator.
+// @returns the final position of the pivot.
 // ----------------------------------------------------------------------------
-void Sort::merge(std::vector<int>& vector, int first, int split, int last) {
-    int n1 = split - first + 1;     // Index of left side
-    int n2 = last - split;          // Index of right side
-    int Left[n1];                   // Left split list
-    int Right[n2];                  // Right split list
+template <class RandomIt, class Less>
+RandomIt Sort::partition_right(RandomIt first, RandomIt last, bool block,
+                               bool& alreadyPartitioned, Less& less) {
+    RandomIt leftIndex = first;      // Left scan
+    RandomIt rightIndex = last;      // Right scan
 
-    // Fill left list
-    for (int i = 0; i < n1; i++) {
-        Left[i] = vector[first + i];
+    // Find the first value not less than pivot
+    while (++leftIndex < last && less(*leftIndex, *first)) {
+    }
+    // Find the last value less than pivot, unguarded once one was skipped
+    if (leftIndex - 1 == first) {
+        while (leftIndex < rightIndex && !less(*--rightIndex, *first)) {
+        }
     }
-    // Fill right list
-    for (int j = 0; j < n2; j++) {
-        Right[j] = vector[split + 1 + j];
+    else {
+        while (!less(*--rightIndex, *first)) {
+        }
     }
 
-    int leftIndex = 0;          // Left list index
-    int rightIndex = 0;         // Right list index
-    int vecIndex = first;       // Vector index
+    // The scans crossed without finding a misplaced pair.
+    alreadyPartitioned = leftIndex >= rightIndex;
+
+    if (!alreadyPartitioned) {
+        std::iter_swap(leftIndex, rightIndex);
+        ++leftIndex;
 
-    while (leftIndex < n1 && rightIndex < n2) {
-        // Sort vector with smaller value from left container.
-        if (Left[leftIndex] <= Right[rightIndex]) {
-            vector[vecIndex] = Left[leftIndex];
-            leftIndex++;
+        if (block) {
+            leftIndex = partition_block_range(first, leftIndex, rightIndex, less);
         }
-        // Sort vector with smaller value from right container.
         else {
-            vector[vecIndex] = Right[rightIndex];
-            rightIndex++;
+            // Both ends now hold a value that stops the opposite scan.
+            while (true) {
+                while (less(*leftIndex, *first)) {
+                    ++leftIndex;
+                }
+                while (!less(*--rightIndex, *first)) {
+                }
+                if (leftIndex >= rightIndex) {
+                    break;
+                }
+                std::iter_swap(leftIndex, rightIndex);
+                ++leftIndex;
+            }
+        }
+    }
+
+    // Move pivot between both sides
+    std::iter_swap(first, leftIndex - 1);
+    return leftIndex - 1;
+}
+
+// ----------------------------------------------------------------------------
+// Partitions a range around the pivot at its front, equal keys going left.
+// @param [in] first The beginning of the range, holding the pivot.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @returns the final position of the pivot, everything before it is equal.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::partition_left(RandomIt first, RandomIt last, Less& less) {
+    RandomIt leftIndex = first;      // Left scan
+    RandomIt rightIndex = last;      // Right scan
+
+    // Find the last value not greater than pivot, the pivot stops it
+    while (less(*first, *--rightIndex)) {
+    }
+    // Find the first value greater than pivot
+    if (rightIndex + 1 == last) {
+        while (leftIndex < rightIndex && !less(*first, *++leftIndex)) {
+        }
+    }
+    else {
+        while (!less(*first, *++leftIndex)) {
+        }
+    }
+
+    while (leftIndex < rightIndex) {
+        std::iter_swap(leftIndex, rightIndex);
+        while (less(*first, *--rightIndex)) {
         }
-        vecIndex++;
+        while (!less(*first, *++leftIndex)) {
+        }
+    }
+
+    // Move pivot behind its equal keys
+    std::iter_swap(first, rightIndex);
+    return rightIndex;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range with insertion sort unless it turns out to be far from sorted.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
+// @returns true if the range was sorted, false if the attempt was abandoned
+// after moving more than PARTIAL_INSERTION_LIMIT elements.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+bool Sort::partial_insertion_sort(RandomIt first, RandomIt last, Less& less) {
+    std::ptrdiff_t moved = 0;       // Elements moved so far
+
+    if (first == last) {
+        return true;
     }
 
-    // Insert remaining elements from left container.
-    while (leftIndex < n1) {
-        vector[vecIndex] = Left[leftIndex];
-        leftIndex++;
-        vecIndex++;
+    for (RandomIt iterator = first + 1; iterator < last; ++iterator) {
+        if (less(*iterator, *(iterator - 1))) {
+            auto temp = std::move(*iterator);
+            RandomIt index = iterator;
+
+            while (index > first && less(temp, *(index - 1))) {
+                *index = std::move(*(index - 1));
+                --index;
+            }
+            *index = std::move(temp);
+            moved += iterator - index;
+        }
+
+        if (moved > PARTIAL_INSERTION_LIMIT) {
+            return false;
+        }
     }
-    // Insert remaining elements from right container.
-    while (rightIndex < n2) {
-        vector[vecIndex] = Right[rightIndex];
-        rightIndex++;
-        vecIndex++;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Swaps elements from the quarter points into the head and tail of a range.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @note Pivot candidates are drawn from the head, middle and tail, moving
+// other elements there defeats inputs crafted against that choice.
+// ----------------------------------------------------------------------------
+template <class RandomIt>
+void Sort::break_patterns(RandomIt first, RandomIt last) {
+    const std::ptrdiff_t size = last - first;      // Elements in the range
+    const std::ptrdiff_t quarter = size / 4;       // Distance to swap over
+
+    if (size > INSERTION_CUTOFF) {
+        std::iter_swap(first, first + quarter);
+        std::iter_swap(last - 1, last - quarter);
+
+        if (size > NINTHER_THRESHOLD) {
+            std::iter_swap(first + 1, first + (quarter + 1));
+            std::iter_swap(first + 2, first + (quarter + 2));
+            std::iter_swap(last - 2, last - (quarter + 1));
+            std::iter_swap(last - 3, last - (quarter + 2));
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using work-stealing quick sort on the shared pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @returns the number of tasks each worker stole.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+Sort::unless_pool<Compare, std::vector<std::size_t>> Sort::parallel_quick_sort(
+    RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    return parallel_quick_sort(first, last, ThreadPool::instance(), 0,
+                               std::move(comp), std::move(proj));
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using work-stealing quick sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] pool The pool whose workers sort, its size is the thread count.
+// @param [in] grain Ranges this short are sorted sequentially, 0 for default.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Each worker owns a deque of sub-ranges. A partition step pushes one
+// side onto the worker's own deque and keeps partitioning the other. Idle
+// workers steal the oldest, and therefore largest, range from another
+// worker. Unbalanced partitions then spread out instead of leaving cores
+// idle. Ranges below the grain size finish with sequential intro sort.
+// Workers with nothing to steal sleep until a range is pushed. If the
+// comparator or a move throws, every worker stops after its current range
+// and the first exception is rethrown, leaving the range partly sorted.
+// @returns the number of tasks each worker stole.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+std::vector<std::size_t> Sort::parallel_quick_sort(RandomIt first, RandomIt last,
+                                                   ThreadPool& pool, std::size_t grain,
+                                                   Compare comp, Projection proj) {
+    // Key type, block partitioning pays off when comparisons are cheap
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    auto less = make_less(std::move(comp), std::move(proj));
+    const std::size_t workers = pool.size();
+    std::vector<std::size_t> steals(workers, 0);
+
+    // Sub-range waiting to be sorted
+    struct task {
+        RandomIt first;     // Beginning of the sub-range
+        RandomIt last;      // End of the sub-range
+        int depth;          // Partitioning levels left before heap sort
+        bool leftmost;      // Whether no element precedes the sub-range
+    };
+
+    if (last - first < 2) {
+        return steals;
+    }
+
+    const std::ptrdiff_t cutoff = grain ? static_cast<std::ptrdiff_t>(grain) : PARALLEL_CUTOFF;
+    const Partition scheme = resolve_partition(first, last, Partition::automatic,
+                                               std::is_arithmetic<key_type>::value, less);
+    const int depth = 2 * log2_floor(last - first);
+
+    // Not worth waking the workers
+    if (last - first <= cutoff || workers < 2) {
+        intro_sort_loop(first, last, depth, scheme, true, less);
+        return steals;
+    }
+
+    std::vector<LockedDeque<task>> deques(workers);
+    std::atomic<std::size_t> pending(1);        // Tasks pushed and not finished
+    std::atomic<std::ptrdiff_t> queued(1);      // Tasks pushed and not taken
+    std::atomic<bool> aborted(false);           // Set once a task threw
+    std::exception_ptr error;                   // First exception thrown
+    std::mutex idleMutex;                       // Guards the idle workers' wait
+    std::condition_variable idle;               // Wakes idle workers
+    deques[0].push({first, last, depth, true});
+
+    // Wakes idle workers, the lock orders it after their last check.
+    auto wake = [&](bool all) {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+        }
+        if (all) {
+            idle.notify_all();
+        }
+        else {
+            idle.notify_one();
+        }
+    };
+
+    pool.run(workers, [&](std::size_t worker) {
+        task current;
+
+        while (pending.load() != 0 && !aborted.load()) {
+            // Own work first, newest range for locality
+            bool found = deques[worker].pop(current);
+
+            // Otherwise steal the oldest range of another worker
+            for (std::size_t offset = 1; !found && offset < workers; offset++) {
+                if (deques[(worker + offset) % workers].steal(current)) {
+                    found = true;
+                    steals[worker]++;
+                }
+            }
+            // Nothing to take, sleep until a range is pushed or the sort ends.
+            if (!found) {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait(lock, [&]() {
+                    return queued.load() > 0 || pending.load() == 0 || aborted.load();
+                });
+                continue;
+            }
+            queued--;
+
+            try {
+                // Partition until the range drops below the grain size.
+                while (current.last - current.first > cutoff && current.depth > 0) {
+                    current.depth--;
+                    std::pair<RandomIt, RandomIt> bounds = intro_partition(
+                        current.first, current.last, scheme, current.leftmost, less);
+
+                    // Publish the larger side, keep partitioning the smaller one.
+                    task left = {current.first, bounds.first, current.depth, current.leftmost};
+                    task right = {bounds.second, current.last, current.depth, false};
+                    pending++;
+                    if (left.last - left.first > right.last - right.first) {
+                        deques[worker].push(left);
+                        current = right;
+                    }
+                    else {
+                        deques[worker].push(right);
+                        current = left;
+                    }
+                    queued++;
+                    wake(false);
+                }
+                intro_sort_loop(current.first, current.last, current.depth,
+                                scheme, current.leftmost, less);
+            }
+            catch (...) {
+                // Keep the first exception and stop every worker.
+                std::lock_guard<std::mutex> lock(idleMutex);
+                if (!aborted.load()) {
+                    error = std::current_exception();
+                    aborted = true;
+                }
+            }
+            if (--pending == 0 || aborted.load()) {
+                wake(true);
+            }
+        }
+    });
+
+    // Rethrown once no worker refers to the range any more
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return steals;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using sample sort on the shared pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+Sort::unless_pool<Compare, void> Sort::parallel_sample_sort(RandomIt first, RandomIt last,
+                                                           Compare comp, Projection proj) {
+    parallel_sample_sort(first, last, ThreadPool::instance(), std::move(comp), std::move(proj));
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using sample sort across the workers of a thread pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] pool The pool whose workers classify and sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Splitters are picked from a sorted random sample, SAMPLE_OVERSAMPLING
+// keys per bucket, with one bucket per worker rounded up to a power of two.
+// Each worker moves its own slice into a scratch buffer and classifies it
+// there while it is still in cache, walking an implicit search tree of the
+// splitters without branching and remembering each element's bucket. Each
+// then moves its elements straight to their bucket's place in the range,
+// the only move after classification. Finally every bucket is pdq sorted
+// on its own. Unlike merge sort there are no merge passes left to
+// saturate memory bandwidth. The sort is not stable. When the sample
+// repeats a splitter, keys equal to a splitter get buckets of their own,
+// which need no sorting, so inputs with few distinct keys do not pile up
+// in one bucket for the last step.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::parallel_sample_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+                                Compare comp, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    auto less = make_less(std::move(comp), std::move(proj));
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+    const std::size_t slices = pool.size();        // One slice per worker
+
+    // Too small to share out
+    if (slices == 1 || size < PARALLEL_CUTOFF * static_cast<std::ptrdiff_t>(slices)) {
+        if (size > 1) {
+            pdq_sort_loop(first, last, log2_floor(size),
+                          std::is_arithmetic<key_type>::value, true, less);
+        }
+        return;
+    }
+
+    // Buckets, a power of two so the search tree is complete. The bucket
+    // of an element, equality buckets included, must fit the oracle.
+    int levels = 1;
+    while ((std::size_t(1) << levels) < slices && levels < 15) {
+        levels++;
+    }
+    const std::size_t buckets = std::size_t(1) << levels;
+
+    // Sorted sample of keys, a fixed seed keeps runs repeatable.
+    std::minstd_rand random(static_cast<std::minstd_rand::result_type>(size));
+    std::uniform_int_distribution<std::ptrdiff_t> position(0, size - 1);
+    std::vector<key_type> sample;
+    for (std::size_t index = 0; index < buckets * SAMPLE_OVERSAMPLING; index++) {
+        sample.push_back(less.proj(first[position(random)]));
+    }
+    intro_sort(sample.begin(), sample.end(), less.comp);
+
+    // Splitters in breadth first order, node n has children 2n and 2n + 1.
+    // Node 0 is unused.
+    std::vector<key_type> tree(1, sample.front());
+    for (std::size_t node = 1; node < buckets; node++) {
+        const int level = log2_floor(node);
+        const std::size_t rank = 2 * (node - (std::size_t(1) << level)) + 1;
+        tree.push_back(sample[rank * (buckets >> (level + 1)) * SAMPLE_OVERSAMPLING]);
+    }
+
+    // Upper splitter of every bucket, the last bucket has none and never
+    // reads its entry. A splitter filling half a bucket's share of the
+    // sample means many equal keys, which then get equality buckets.
+    std::vector<key_type> upper;
+    bool repeated = false;
+    for (std::size_t bucket = 0; bucket < buckets; bucket++) {
+        const std::size_t rank = std::min(bucket + 1, buckets - 1) * SAMPLE_OVERSAMPLING;
+        upper.push_back(sample[rank]);
+        repeated = repeated || (bucket + 1 < buckets
+                                && !less.comp(sample[rank - SAMPLE_OVERSAMPLING / 2], sample[rank]));
+    }
+    // Classes an element can fall in, bucket b's equal keys are class 2b + 1
+    const std::size_t classes = repeated ? 2 * buckets : buckets;
+
+    // Start of a slice, the last one ends at the range's end
+    auto sliceBegin = [size, slices](std::size_t slice) {
+        return static_cast<std::ptrdiff_t>(size * slice / slices);
+    };
+
+    // Scratch buffer the elements are scattered back from, trivial elements
+    // are moved in by the workers below.
+    auto scratch = scratch_buffer(first, last, std::is_trivial<value_type>());
+    value_type* buffer = &scratch[0];
+    std::unique_ptr<std::uint16_t[]> oracle(new std::uint16_t[size]);  // Class per element
+    std::vector<std::size_t> offsets(slices * classes);    // Counts, then write offsets
+
+    // Every worker moves its own slice in and classifies it there.
+    pool.run(slices, [&](std::size_t slice) {
+        std::size_t* counts = &offsets[slice * classes];
+        std::fill(counts, counts + classes, 0);
+        if (std::is_trivial<value_type>::value) {
+            std::move(first + sliceBegin(slice), first + sliceBegin(slice + 1),
+                      buffer + sliceBegin(slice));
+        }
+        sample_classify(buffer + sliceBegin(slice), buffer + sliceBegin(slice + 1),
+                        tree.data(), levels, repeated ? upper.data() : nullptr,
+                        oracle.get() + sliceBegin(slice), counts, less);
+    });
+
+    // Classes in order, and the slices in order within a class
+    std::vector<std::ptrdiff_t> bounds;            // Class c spans [bounds[c], bounds[c + 1])
+    std::size_t total = 0;                         // Elements placed so far
+    for (std::size_t bucket = 0; bucket < classes; bucket++) {
+        bounds.push_back(static_cast<std::ptrdiff_t>(total));
+        for (std::size_t slice = 0; slice < slices; slice++) {
+            std::size_t count = offsets[slice * classes + bucket];
+            offsets[slice * classes + bucket] = total;
+            total += count;
+        }
+    }
+    bounds.push_back(size);
+
+    // Every worker moves its slice to its own offsets.
+    pool.run(slices, [&](std::size_t slice) {
+        std::size_t* slots = &offsets[slice * classes];
+        for (std::ptrdiff_t index = sliceBegin(slice); index < sliceBegin(slice + 1); index++) {
+            first[slots[oracle[index]]++] = std::move(buffer[index]);
+        }
+    });
+
+    // Every bucket is sorted on its own, claimed by whichever worker is free.
+    // Equality buckets hold equal keys only.
+    pool.run(classes, [&](std::size_t bucket) {
+        const std::ptrdiff_t length = bounds[bucket + 1] - bounds[bucket];
+        if (length > 1 && !(repeated && bucket % 2 == 1)) {
+            pdq_sort_loop(first + bounds[bucket], first + bounds[bucket + 1], log2_floor(length),
+                          std::is_arithmetic<key_type>::value, true, less);
+        }
+    });
+}
+
+// ----------------------------------------------------------------------------
+// Finds the sample sort bucket of every element of a slice.
+// @param [in] first The beginning of the elements to classify.
+// @param [in] last One past the end of the elements to classify.
+// @param [in] tree Splitters in breadth first order from node 1.
+// @param [in] levels Depth of the tree, there are 2^levels buckets.
+// @param [in] upper Upper splitter of every bucket, or null for no
+// equality buckets.
+// @param [out] oracle Receives the bucket of every element.
+// @param [in] counts Bucket counts, incremented for every element.
+// @param [in] less The projected comparator.
+// @note Each level steps to a child by adding the comparison to twice the
+// node, so no branch depends on the keys. Keys equal to a splitter go left.
+// SAMPLE_UNROLL elements walk down together, so their loads and comparisons
+// overlap instead of waiting on each other. With equality buckets, bucket b
+// becomes 2b, or 2b + 1 for keys equal to its upper splitter.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Key, class Less>
+void Sort::sample_classify(InputIt first, InputIt last, const Key* tree, int levels,
+                           const Key* upper, std::uint16_t* oracle, std::size_t* counts,
+                           Less& less) {
+    const std::size_t buckets = std::size_t(1) << levels;
+    const std::ptrdiff_t size = last - first;      // Elements to classify
+    std::ptrdiff_t index = 0;
+
+    // Class of an element given its bucket
+    auto split = [&](std::size_t bucket, InputIt element) {
+        if (upper == nullptr) {
+            return bucket;
+        }
+        return 2 * bucket + static_cast<std::size_t>(
+            (bucket + 1 < buckets) & !less.comp(less.proj(*element), upper[bucket]));
+    };
+
+    for (; index + SAMPLE_UNROLL <= size; index += SAMPLE_UNROLL) {
+        std::size_t nodes[SAMPLE_UNROLL];
+        for (std::ptrdiff_t lane = 0; lane < SAMPLE_UNROLL; lane++) {
+            nodes[lane] = 1;
+        }
+        for (int level = 0; level < levels; level++) {
+            for (std::ptrdiff_t lane = 0; lane < SAMPLE_UNROLL; lane++) {
+                nodes[lane] = 2 * nodes[lane] + static_cast<std::size_t>(
+                    less.comp(tree[nodes[lane]], less.proj(first[index + lane])));
+            }
+        }
+        for (std::ptrdiff_t lane = 0; lane < SAMPLE_UNROLL; lane++) {
+            const std::size_t bucket = split(nodes[lane] - buckets, first + (index + lane));
+            oracle[index + lane] = static_cast<std::uint16_t>(bucket);
+            counts[bucket]++;
+        }
+    }
+
+    // Leftover elements walk down alone.
+    for (; index < size; index++) {
+        std::size_t node = 1;
+        for (int level = 0; level < levels; level++) {
+            node = 2 * node + static_cast<std::size_t>(
+                less.comp(tree[node], less.proj(first[index])));
+        }
+        const std::size_t bucket = split(node - buckets, first + index);
+        oracle[index] = static_cast<std::uint16_t>(bucket);
+        counts[bucket]++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the heap sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::heap_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+    heap_sort_loop(first, last, less);
+}
+
+// ----------------------------------------------------------------------------
+// Builds a max-heap over a range and repeatedly pops its root to the back.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::heap_sort_loop(RandomIt first, RandomIt last, Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements in the heap
+
+    // Heapify from the last parent upwards
+    for (std::ptrdiff_t parent = size / 2 - 1; parent >= 0; --parent) {
+        sift_down(first, parent, size, less);
+    }
+    // Move the largest value behind the shrinking heap
+    for (std::ptrdiff_t end = size - 1; end > 0; --end) {
+        std::iter_swap(first, first + end);
+        sift_down(first, 0, end, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sifts the element at a hole down until both children are not larger.
+// @param [in] first The beginning of the heap.
+// @param [in] hole Index of the element to sift down.
+// @param [in] size Number of elements in the heap.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::sift_down(RandomIt first, std::ptrdiff_t hole, std::ptrdiff_t size, Less& less) {
+    auto value = std::move(*(first + hole));       // Element being sifted
+    std::ptrdiff_t child = 2 * hole + 1;           // Left child of the hole
+
+    while (child < size) {
+        // Pick the larger child
+        if (child + 1 < size && less(*(first + child), *(first + child + 1))) {
+            ++child;
+        }
+        if (!less(value, *(first + child))) {
+            break;
+        }
+        // Move the child up into the hole
+        *(first + hole) = std::move(*(first + child));
+        hole = child;
+        child = 2 * hole + 1;
+    }
+    *(first + hole) = std::move(value);
+}
+
+// ----------------------------------------------------------------------------
+// Computes the integer base two logarithm of a value.
+// @param [in] value The value, greater than zero.
+// @returns floor(log2(value)).
+// ----------------------------------------------------------------------------
+inline int Sort::log2_floor(std::size_t value) {
+    int log = 0;
+    while (value >>= 1) {
+        ++log;
+    }
+    return log;
+}
+
+// ----------------------------------------------------------------------------
+// Allocates scratch room for trivial elements without touching it.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @note Nothing is constructed, so the parallel sorts fill the room from
+// every worker at once instead of moving the range in on one thread.
+// @returns the room, as long as the range.
+// ----------------------------------------------------------------------------
+template <class RandomIt>
+std::unique_ptr<typename std::iterator_traits<RandomIt>::value_type[]>
+Sort::scratch_buffer(RandomIt first, RandomIt last, std::true_type) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    return std::unique_ptr<value_type[]>(new value_type[last - first]);
+}
+
+// ----------------------------------------------------------------------------
+// Allocates scratch room for elements that must be constructed.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @note Elements need not be default constructible, so the room is built by
+// moving the range in, and the caller takes the elements from it.
+// @returns the room, holding the range's elements.
+// ----------------------------------------------------------------------------
+template <class RandomIt>
+std::vector<typename std::iterator_traits<RandomIt>::value_type>
+Sort::scratch_buffer(RandomIt first, RandomIt last, std::false_type) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    return std::vector<value_type>(std::make_move_iterator(first), std::make_move_iterator(last));
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the merge sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note A single scratch buffer of size N is allocated up front by moving
+// the input into it, the recursion then ping-pongs between the buffer and
+// the range so no level allocates again.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::merge_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    // Scratch buffer holding the elements, sorted back into the range.
+    std::vector<value_type> buffer(std::make_move_iterator(first),
+                                   std::make_move_iterator(last));
+    merge_sort_into(buffer.begin(), buffer.end(), first, less);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the merge sort algorithm with a caller supplied arena.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] arena Scratch storage, its capacity grown to the range size
+// when smaller.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note The input is moved into the arena as in merge_sort, so elements
+// need only be move constructible, never default constructible. Clearing
+// keeps the arena's capacity, so reusing it across calls makes merge sort
+// allocation free. Its contents are left in a moved-from state.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::merge_sort(RandomIt first, RandomIt last,
+                      std::vector<typename std::iterator_traits<RandomIt>::value_type>& arena,
+                      Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    // Move the elements into the arena, it reallocates only when too small.
+    arena.clear();
+    arena.insert(arena.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+    merge_sort_into(arena.begin(), arena.end(), first, less);
+}
+
+// ----------------------------------------------------------------------------
+// Recursively splits and merges a range in place for merge sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] buffer Scratch storage at least as long as the range.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class BufferIt, class Less>
+void Sort::merge_sort_loop(RandomIt first, RandomIt last, BufferIt buffer, Less& less) {
+    // Small list
+    if (last - first <= small_sort_cutoff<RandomIt, Less>()) {
+        small_sort_loop(first, last, less);
+    }
+    else {
+        RandomIt split = first + (last - first) / 2;     // Position to split list
+        BufferIt bufferSplit = buffer + (split - first); // Matching buffer position
+
+        // Sort left side into the buffer
+        merge_sort_into(first, split, buffer, less);
+        // Sort right side into the buffer
+        merge_sort_into(split, last, bufferSplit, less);
+
+        // Merge lists back into the range
+        merge(buffer, bufferSplit, bufferSplit, buffer + (last - first), first, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Recursively splits and merges a range, leaving the result in the output.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [out] out The beginning of the destination, as long as the range.
+// @param [in] less The projected comparator.
+// @note The range itself serves as scratch storage for the lower level.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class OutputIt, class Less>
+void Sort::merge_sort_into(RandomIt first, RandomIt last, OutputIt out, Less& less) {
+    // Small list, sorted once moved to the output
+    if (last - first <= small_sort_cutoff<OutputIt, Less>()) {
+        OutputIt outLast = std::move(first, last, out);
+        small_sort_loop(out, outLast, less);
+    }
+    else {
+        RandomIt split = first + (last - first) / 2;     // Position to split list
+
+        // Sort left side in place
+        merge_sort_loop(first, split, out, less);
+        // Sort right side in place
+        merge_sort_loop(split, last, out + (split - first), less);
+
+        // Merge lists into the output
+        merge(first, split, split, last, out, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the bottom-up (non-recursive) merge sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Blocks sized to half of L2 (the other half holds their scratch) are
+// first sorted on their own, starting from insertion sorted runs. Widening
+// passes then merge the blocks two at a time, streaming sequentially
+// through the range and one scratch buffer.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::merge_sort_bottom_up(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    if (last - first < 2) {
+        return;
+    }
+    multiway_merge_loop(first, last, 2, less, std::false_type());
+}
+
+// ----------------------------------------------------------------------------
+// Sorts every cache-sized block of a range where the elements are.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] buffer The scratch buffer, as long as the range.
+// @param [in] inBuffer Whether the elements are in the buffer rather than
+// the range.
+// @param [in] less The projected comparator.
+// @note Blocks are the largest BASE_RUN * 4^k elements within half of L2,
+// the other half holding their scratch, the block's slice of the other
+// side. Every block ends up sorted on the side it started on.
+// @returns the block length, the run width the merge passes start from.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+std::ptrdiff_t Sort::merge_sort_blocks(
+    RandomIt first, RandomIt last, typename std::iterator_traits<RandomIt>::value_type* buffer,
+    bool inBuffer, Less& less) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+    const std::ptrdiff_t cacheElements = L2_CACHE_BYTES / 2 / sizeof(value_type);
+    std::ptrdiff_t block = BASE_RUN;
+
+    while (block * 4 <= cacheElements) {
+        block *= 4;
+    }
+
+    for (std::ptrdiff_t start = 0; start < size; start += block) {
+        const std::ptrdiff_t end = start + block < size ? start + block : size;
+        if (inBuffer) {
+            merge_sort_block(buffer + start, buffer + end, first + start, BASE_RUN, less);
+        }
+        else {
+            merge_sort_block(first + start, first + end, buffer + start, BASE_RUN, less);
+        }
+    }
+    return block;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range bottom-up, merging k runs at a time in every pass.
+// @param [in] first The beginning of the range of elements to sort, at
+// least two elements long.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] ways Runs merged at once, at least two.
+// @param [in] less The projected comparator.
+// @param [in] funnel Whether the passes merge through a funnel rather than
+// loser trees.
+// @note Driver shared by bottom-up, multiway and tiled merge sort. They
+// differ only in the fan-in and in what merges a group of runs. Trivial
+// elements have their blocks sorted in place, with the untouched buffer as
+// scratch. Others are first moved into the buffer, which costs a pass.
+// @returns the passes over the whole range, each reading and writing every
+// element once: the block pass, then every merge pass and move.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less, bool Funnel>
+std::size_t Sort::multiway_merge_loop(RandomIt first, RandomIt last, std::size_t ways,
+                                      Less& less, std::integral_constant<bool, Funnel> funnel) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+    auto scratch = scratch_buffer(first, last, std::is_trivial<value_type>());
+    value_type* buffer = &scratch[0];               // Scratch the passes run from
+    bool inBuffer = !std::is_trivial<value_type>::value;    // Side holding the elements
+    const std::ptrdiff_t block = merge_sort_blocks(first, last, buffer, inBuffer, less);
+    std::size_t passes = inBuffer ? 2 : 1;          // Into the buffer, and the blocks
+
+    // Merge groups of runs in widening passes, alternating between buffer and range.
+    for (std::ptrdiff_t width = block; width < size;
+         width *= static_cast<std::ptrdiff_t>(ways)) {
+        multiway_merge_pass(first, last, buffer, !inBuffer, width, ways, less, funnel);
+        inBuffer = !inBuffer;
+        ++passes;
+    }
+
+    // Move the result back when the last pass ended in the buffer.
+    if (inBuffer) {
+        std::move(buffer, buffer + size, first);
+        ++passes;
+    }
+    return passes;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using bottom-up merge sort with k runs merged per pass.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] ways Runs merged at once, at least two.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Cache-sized blocks are sorted as in merge_sort_bottom_up, then each
+// pass merges groups of k blocks with a loser tree, so the passes over
+// main memory drop from log2 to logk of the block count. Groups of two
+// use the branch-free merge.
+// @returns the passes over the whole range, each reading and writing every
+// element once, so 2 * sizeof(value_type) bytes per element and pass.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+std::size_t Sort::multiway_merge_sort(RandomIt first, RandomIt last, std::size_t ways,
+                                      Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    if (last - first < 2) {
+        return 0;
+    }
+    return multiway_merge_loop(first, last, ways < 2 ? 2 : ways, less, std::false_type());
+}
+
+// ----------------------------------------------------------------------------
+// Performs one widening pass of multiway merge sort.
+// @param [in] first The beginning of the runs to merge.
+// @param [in] size Number of elements in the runs.
+// @param [in] width Length of every run except possibly the last.
+// @param [in] ways Runs merged into each output run.
+// @param [out] out The beginning of the destination, as long as the runs.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Less>
+void Sort::multiway_merge_pass(InputIt first, std::ptrdiff_t size, std::ptrdiff_t width,
+                               std::size_t ways, OutputIt out, Less& less) {
+    const std::ptrdiff_t group = width * static_cast<std::ptrdiff_t>(ways);
+    std::vector<std::pair<InputIt, InputIt>> runs;     // Runs of the current group
+
+    for (std::ptrdiff_t start = 0; start < size; start += group) {
+        // Clamp every run to the end of the range.
+        runs.clear();
+        for (std::ptrdiff_t run = start; run < size && run < start + group; run += width) {
+            runs.emplace_back(first + run, first + (run + width < size ? run + width : size));
+        }
+
+        // A lone trailing run is moved across unchanged.
+        if (runs.size() == 1) {
+            std::move(runs[0].first, runs[0].second, out + start);
+        }
+        else if (runs.size() == 2) {
+            merge(runs[0].first, runs[0].second, runs[1].first, runs[1].second,
+                  out + start, less);
+        }
+        else {
+            LoserTree<InputIt, Less> tree(runs, less);
+            tree.merge(out + start);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using cache-aware tiled merge sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Recursive merge sort streams the whole range through memory once per
+// level, so it slows down once the range outgrows the cache. This is
+// multiway merge sort whose groups of L2-sized tiles merge through a funnel
+// with node buffers fitting in L2 together, so memory is streamed logk
+// instead of log2 times for the tiles and every comparison stays a
+// branch-free two-way step. Contiguous trivially copyable elements take the
+// funnel, others a loser tree.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::tiled_merge_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    if (last - first < 2) {
+        return;
+    }
+    multiway_merge_loop(first, last, tiled_fan_in(sizeof(value_type)), less,
+                        funnel_mergeable<RandomIt>());
+}
+
+// ----------------------------------------------------------------------------
+// Fan-in of tiled merge sort for an element size.
+// @param [in] elementBytes Size of one element.
+// @note TILED_FAN_IN is halved until the funnel's buffers, one per run,
+// each hold TILED_MIN_BUFFER elements within half of L2. Larger fan-ins
+// save passes but add a two-way merge per element for every doubling.
+// @returns the runs merged at once, a power of two and at least two.
+// ----------------------------------------------------------------------------
+constexpr std::size_t Sort::tiled_fan_in(std::size_t elementBytes) {
+    std::size_t ways = TILED_FAN_IN;
+
+    while (ways > 2 && ways * TILED_MIN_BUFFER * elementBytes > L2_CACHE_BYTES / 2) {
+        ways /= 2;
+    }
+    return ways;
+}
+
+// ----------------------------------------------------------------------------
+// Performs one multiway merge sort pass through loser trees.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @param [in] buffer The scratch buffer, as long as the range.
+// @param [in] toBuffer Whether the runs are in the range and merge to the buffer.
+// @param [in] width Length of every run except possibly the last.
+// @param [in] ways Runs merged into each output run.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::multiway_merge_pass(RandomIt first, RandomIt last,
+                               typename std::iterator_traits<RandomIt>::value_type* buffer,
+                               bool toBuffer, std::ptrdiff_t width, std::size_t ways,
+                               Less& less, std::false_type) {
+    const std::ptrdiff_t size = last - first;
+    if (toBuffer) {
+        multiway_merge_pass(first, size, width, ways, buffer, less);
+    }
+    else {
+        multiway_merge_pass(buffer, size, width, ways, first, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Performs one multiway merge sort pass through a funnel.
+// @param [in] first The beginning of the range.
+// @param [in] last One past the end of the range.
+// @param [in] buffer The scratch buffer, as long as the range.
+// @param [in] toBuffer Whether the runs are in the range and merge to the buffer.
+// @param [in] width Length of every run except possibly the last.
+// @param [in] ways Runs merged into each output run.
+// @param [in] less The projected comparator.
+// @note The funnel gives each of its nodes a buffer sized so all of them
+// share half of L2, and is reused by every group of the pass.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::multiway_merge_pass(RandomIt first, RandomIt last,
+                               typename std::iterator_traits<RandomIt>::value_type* buffer,
+                               bool toBuffer, std::ptrdiff_t width, std::size_t ways,
+                               Less& less, std::true_type) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    const std::ptrdiff_t size = last - first;
+    const std::ptrdiff_t group = width * static_cast<std::ptrdiff_t>(ways);
+    value_type* range = &*first;
+    const value_type* in = toBuffer ? range : buffer;
+    value_type* out = toBuffer ? buffer : range;
+    MergeFunnel<value_type, Less> funnel(ways, L2_CACHE_BYTES / 2 / ways / sizeof(value_type),
+                                         less);
+    std::vector<std::pair<const value_type*, const value_type*>> runs;
+
+    for (std::ptrdiff_t start = 0; start < size; start += group) {
+        // Clamp every run to the end of the range.
+        runs.clear();
+        for (std::ptrdiff_t run = start; run < size && run < start + group; run += width) {
+            runs.emplace_back(in + run, in + (run + width < size ? run + width : size));
+        }
+
+        // A lone trailing run is copied across unchanged.
+        if (runs.size() == 1) {
+            std::copy(runs[0].first, runs[0].second, out + start);
+        }
+        else {
+            funnel.merge(runs, out + start);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges any number of sorted runs into one sorted output.
+// @param [in] runs The sorted runs, viewed in place.
+// @param [out] out The beginning of the destination, as long as every run
+// together and overlapping none of them.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note Elements of mutable spans are moved out, const spans are copied.
+// Equal keys come out in the order of their runs. Two runs take the
+// branch-free merge, more runs a loser tree.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class T, class OutputIt, class Compare, class Projection>
+OutputIt Sort::kway_merge(const std::vector<Span<T>>& runs, OutputIt out,
+                          Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+    std::vector<std::pair<T*, T*>> ranges;
+
+    for (const auto& run : runs) {
+        ranges.emplace_back(run.begin(), run.end());
+    }
+    return kway_merge_loop(ranges, out, less);
+}
+
+// ----------------------------------------------------------------------------
+// Merges sorted runs given as pointer ranges into one sorted output.
+// @param [in] runs First and last pointer of every sorted run, empty runs
+// are dropped from it.
+// @param [out] out The beginning of the destination.
+// @param [in] less The projected comparator.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class T, class OutputIt, class Less>
+OutputIt Sort::kway_merge_loop(std::vector<std::pair<T*, T*>>& runs, OutputIt out,
+                               Less& less) {
+    runs.erase(std::remove_if(runs.begin(), runs.end(),
+                              [](const std::pair<T*, T*>& run) {
+                                  return run.first == run.second;
+                              }),
+               runs.end());
+
+    if (runs.empty()) {
+        return out;
+    }
+    if (runs.size() == 1) {
+        return std::move(runs[0].first, runs[0].second, out);
+    }
+    if (runs.size() == 2) {
+        return merge(runs[0].first, runs[0].second, runs[1].first, runs[1].second, out, less);
+    }
+    LoserTree<T*, Less> tree(runs, less);
+    return tree.merge(out);
+}
+
+// ----------------------------------------------------------------------------
+// Merges sorted runs into one sorted output using the shared pool.
+// @param [in] runs The sorted runs, viewed in place.
+// @param [out] out The beginning of the random access destination.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class T, class OutputIt, class Compare, class Projection>
+Sort::unless_pool<Compare, OutputIt> Sort::parallel_kway_merge(const std::vector<Span<T>>& runs,
+                                                              OutputIt out, Compare comp,
+                                                              Projection proj) {
+    return parallel_kway_merge(runs, out, ThreadPool::instance(),
+                               std::move(comp), std::move(proj));
+}
+
+// ----------------------------------------------------------------------------
+// Merges sorted runs into one sorted output across the workers of a pool.
+// @param [in] runs The sorted runs, viewed in place.
+// @param [out] out The beginning of the random access destination, as long
+// as every run together and overlapping none of them.
+// @param [in] pool The pool whose workers merge.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note The output is cut into one equal slice per worker. The cuts are
+// found in each run by multi-sequence selection, all of them before any
+// slice merges, since mutable runs are moved from. Every slice then merges
+// its parts with kway_merge, so the slices share no state. The selection
+// follows the same tie order as the sequential merge, so the output is
+// identical to kway_merge.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class T, class OutputIt, class Compare, class Projection>
+OutputIt Sort::parallel_kway_merge(const std::vector<Span<T>>& runs, OutputIt out,
+                                   ThreadPool& pool, Compare comp, Projection proj) {
+    auto less = make_less(std::move(comp), std::move(proj));
+    const std::ptrdiff_t slices = static_cast<std::ptrdiff_t>(pool.size());
+    std::vector<std::pair<T*, T*>> ranges;
+    std::ptrdiff_t size = 0;                        // Elements to merge
+
+    for (const auto& run : runs) {
+        ranges.emplace_back(run.begin(), run.end());
+        size += static_cast<std::ptrdiff_t>(run.size());
+    }
+
+    // Not worth waking the workers
+    if (size < PARALLEL_CUTOFF || slices < 2) {
+        return kway_merge_loop(ranges, out, less);
+    }
+
+    // Elements of every run before each slice's first output rank
+    std::vector<std::vector<std::ptrdiff_t>> cuts(slices + 1);
+    pool.run(cuts.size(), [&](std::size_t cut) {
+        multi_co_rank(size * static_cast<std::ptrdiff_t>(cut) / slices, ranges, cuts[cut], less);
+    });
+
+    pool.run(slices, [&](std::size_t slice) {
+        const std::ptrdiff_t from = size * static_cast<std::ptrdiff_t>(slice) / slices;
+        const std::vector<std::ptrdiff_t>& starts = cuts[slice];
+        const std::vector<std::ptrdiff_t>& ends = cuts[slice + 1];
+
+        std::vector<std::pair<T*, T*>> parts;
+        for (std::size_t run = 0; run < ranges.size(); run++) {
+            parts.emplace_back(ranges[run].first + starts[run], ranges[run].first + ends[run]);
+        }
+        kway_merge_loop(parts, out + from, less);
+    });
+
+    return out + size;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a cache-resident block in place for bottom-up merge sort.
+// @param [in] first The beginning of the block to sort.
+// @param [in] last One past the end of the block to sort.
+// @param [in] buffer Scratch storage at least as long as the block.
+// @param [in] run Length of the insertion sorted runs to start from.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class BufferIt, class Less>
+void Sort::merge_sort_block(RandomIt first, RandomIt last, BufferIt buffer,
+                            std::ptrdiff_t run, Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements in the block
+
+    // Small-sort kernel over the base runs.
+    for (std::ptrdiff_t start = 0; start < size; start += run) {
+        small_sort_loop(first + start, first + (start + run < size ? start + run : size), less);
+    }
+
+    // Merge runs in widening passes while the block stays in cache.
+    bool inBlock = true;
+    for (std::ptrdiff_t width = run; width < size; width *= 2) {
+        if (inBlock) {
+            merge_pass(first, size, width, buffer, less);
+        }
+        else {
+            merge_pass(buffer, size, width, first, less);
+        }
+        inBlock = !inBlock;
+    }
+
+    // A short trailing block may need an odd number of passes.
+    if (!inBlock) {
+        std::move(buffer, buffer + size, first);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Performs one widening pass of bottom-up merge sort.
+// @param [in] first The beginning of the runs to merge.
+// @param [in] size Number of elements in the runs.
+// @param [in] width Length of every run except possibly the last.
+// @param [out] out The beginning of the destination, as long as the runs.
+// @param [in] less The projected comparator.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Less>
+void Sort::merge_pass(InputIt first, std::ptrdiff_t size, std::ptrdiff_t width,
+                      OutputIt out, Less& less) {
+    for (std::ptrdiff_t start = 0; start < size; start += 2 * width) {
+        // Clamp both runs to the end of the range.
+        const std::ptrdiff_t split = start + width < size ? start + width : size;
+        const std::ptrdiff_t end = split + width < size ? split + width : size;
+
+        // A lone trailing run is moved across unchanged.
+        merge(first + start, first + split, first + split, first + end, out + start, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the TimSort algorithm, a stable adaptive merge sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note The range is cut into its natural runs, ascending or strictly
+// descending (reversed in place, which keeps it stable). Runs shorter than
+// the minimum run length are extended with binary insertion sort. The
+// pending runs are kept on a stack whose lengths grow at least like the
+// Fibonacci numbers, so merges stay balanced, and merges gallop once one
+// run keeps winning. Sorted input is a single run and costs N - 1
+// comparisons, mostly sorted input little more.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::tim_sort(RandomIt first, RandomIt last, Compare comp, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    auto less = make_less(std::move(comp), std::move(proj));
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+
+    if (size < 2) {
+        return;
+    }
+
+    const std::ptrdiff_t minRun = tim_min_run(size);           // Shortest run kept
+    std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>> runs; // Start and length of pending runs
+    std::vector<value_type> buffer;                             // Holds the shorter run of a merge
+    std::ptrdiff_t minGallop = MIN_GALLOP;                      // Adapts to how well galloping pays
+
+    for (RandomIt runStart = first; runStart != last; ) {
+        RandomIt runEnd = tim_count_run(runStart, last, less);
+
+        // Extend a short run to the minimum length
+        if (runEnd - runStart < minRun) {
+            RandomIt forcedEnd = last - runStart > minRun ? runStart + minRun : last;
+            binary_insertion_sort(runStart, runEnd, forcedEnd, less);
+            runEnd = forcedEnd;
+        }
+
+        runs.emplace_back(runStart - first, runEnd - runStart);
+        tim_collapse(first, runs, false, buffer, minGallop, less);
+        runStart = runEnd;
+    }
+
+    // Merge whatever is left on the stack
+    tim_collapse(first, runs, true, buffer, minGallop, less);
+}
+
+// ----------------------------------------------------------------------------
+// Computes the length TimSort extends short natural runs to.
+// @param [in] size Number of elements to sort.
+// @note Taking the top six bits of the size, plus one if any lower bit is
+// set, makes the number of runs a power of two or just below one, which
+// keeps the final merges balanced.
+// @returns the minimum run length, between 32 and 64 for long ranges.
+// ----------------------------------------------------------------------------
+inline std::ptrdiff_t Sort::tim_min_run(std::ptrdiff_t size) {
+    std::ptrdiff_t lowBits = 0;        // Set once a shifted out bit was set
+
+    while (size >= TIM_MIN_MERGE) {
+        lowBits |= size & 1;
+        size >>= 1;
+    }
+    return size + lowBits;
+}
+
+// ----------------------------------------------------------------------------
+// Finds the natural run starting at the front of a range.
+// @param [in] first The beginning of the range, not empty.
+// @param [in] last One past the end of the range.
+// @param [in] less The projected comparator.
+// @note A strictly descending run is reversed into an ascending one. Equal
+// neighbours end a descending run, so reversing never reorders equal keys.
+// @returns one past the end of the run.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+RandomIt Sort::tim_count_run(RandomIt first, RandomIt last, Less& less) {
+    RandomIt runEnd = first + 1;       // One past the end of the run
+
+    if (runEnd == last) {
+        return runEnd;
+    }
+
+    // Strictly descending run
+    if (less(*runEnd, *first)) {
+        ++runEnd;
+        while (runEnd != last && less(*runEnd, *(runEnd - 1))) {
+            ++runEnd;
+        }
+        std::reverse(first, runEnd);
+    }
+    // Ascending run
+    else {
+        ++runEnd;
+        while (runEnd != last && !less(*runEnd, *(runEnd - 1))) {
+            ++runEnd;
+        }
+    }
+    return runEnd;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range whose front is already sorted with binary insertion sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] sorted One past the end of the sorted front, after first.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] less The projected comparator.
+// @note Each element is placed after the equal keys before it, keeping the
+// sort stable, with a logarithmic number of comparisons.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::binary_insertion_sort(RandomIt first, RandomIt sorted, RandomIt last, Less& less) {
+    for (RandomIt next = sorted; next != last; ++next) {
+        auto value = std::move(*next);
+        RandomIt low = first;          // Search window, value belongs in [low, high]
+        RandomIt high = next;
+
+        while (low < high) {
+            RandomIt middle = low + (high - low) / 2;
+            if (less(value, *middle)) {
+                high = middle;
+            }
+            else {
+                low = middle + 1;
+            }
+        }
+        std::move_backward(low, next, next + 1);
+        *low = std::move(value);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges pending runs until the TimSort invariants hold for the stack.
+// @param [in] first The beginning of the range being sorted.
+// @param [in] runs Start and length of the pending runs, oldest first.
+// @param [in] force Whether to merge every run, once the range is consumed.
+// @param [in] buffer Scratch storage for the merges.
+// @param [in] minGallop Galloping threshold, carried across merges.
+// @param [in] less The projected comparator.
+// @note With lengths A, B, C, D from the bottom of the top four runs, the
+// invariants are C > D and B > C + D, also checked one run deeper as
+// well, since checking only the top three can let a violation slip in
+// below them.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Buffer, class Less>
+void Sort::tim_collapse(RandomIt first,
+                        std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>>& runs,
+                        bool force, Buffer& buffer, std::ptrdiff_t& minGallop, Less& less) {
+    while (runs.size() > 1) {
+        std::size_t index = runs.size() - 2;       // Left run of the next merge
+
+        if (force) {
+            if (index > 0 && runs[index - 1].second < runs[index + 1].second) {
+                --index;
+            }
+        }
+        else if ((index > 0 && runs[index - 1].second <= runs[index].second
+                                                         + runs[index + 1].second) ||
+                 (index > 1 && runs[index - 2].second <= runs[index - 1].second
+                                                         + runs[index].second)) {
+            // Merge the middle run with its shorter neighbour
+            if (runs[index - 1].second < runs[index + 1].second) {
+                --index;
+            }
+        }
+        else if (runs[index].second > runs[index + 1].second) {
+            break;
+        }
+        tim_merge_at(first, runs, index, buffer, minGallop, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges the pending run at an index with the run after it.
+// @param [in] first The beginning of the range being sorted.
+// @param [in] runs Start and length of the pending runs.
+// @param [in] index Position of the left run on the stack.
+// @param [in] buffer Scratch storage for the merge.
+// @param [in] minGallop Galloping threshold, carried across merges.
+// @param [in] less The projected comparator.
+// @note Elements of the left run not above the right run's first element,
+// and elements of the right run not below the left run's last element,
+// are already in place. Only the rest is merged, copying whichever side
+// is shorter into the buffer.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Buffer, class Less>
+void Sort::tim_merge_at(RandomIt first,
+                        std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>>& runs,
+                        std::size_t index, Buffer& buffer, std::ptrdiff_t& minGallop,
+                        Less& less) {
+    RandomIt base1 = first + runs[index].first;        // Left run
+    std::ptrdiff_t size1 = runs[index].second;
+    RandomIt base2 = base1 + size1;                     // Right run
+    std::ptrdiff_t size2 = runs[index + 1].second;
+
+    runs[index].second = size1 + size2;
+    runs.erase(runs.begin() + static_cast<std::ptrdiff_t>(index) + 1);
+
+    // Skip the front of the left run already in place
+    const std::ptrdiff_t skip = gallop_right(*base2, base1, size1, 0, less);
+    base1 += skip;
+    size1 -= skip;
+    if (size1 == 0) {
+        return;
+    }
+    // Drop the back of the right run already in place
+    size2 = gallop_left(*(base1 + (size1 - 1)), base2, size2, size2 - 1, less);
+    if (size2 == 0) {
+        return;
+    }
+
+    if (size1 <= size2) {
+        tim_merge_low(base1, size1, base2, size2, buffer, minGallop, less);
+    }
+    else {
+        tim_merge_high(base1, size1, base2, size2, buffer, minGallop, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges two neighbouring runs front to back, the left one copied aside.
+// @param [in] base1 The beginning of the left run.
+// @param [in] size1 Length of the left run, at most size2.
+// @param [in] base2 The beginning of the right run, right after the left.
+// @param [in] size2 Length of the right run.
+// @param [in] buffer Scratch storage, receives the left run.
+// @param [in] minGallop Galloping threshold, adapted to the merge.
+// @param [in] less The projected comparator.
+// @note The right run starts below the left run's first element and its
+// last element is above every right run element, both ensured by
+// tim_merge_at. Merging goes one element at a time until a run wins
+// minGallop times in a row, then gallops, copying whole stretches found
+// by exponential search, until neither run wins MIN_GALLOP at once.
+// Galloping that pays lowers minGallop, leaving it raises it.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Buffer, class Less>
+void Sort::tim_merge_low(RandomIt base1, std::ptrdiff_t size1, RandomIt base2,
+                         std::ptrdiff_t size2, Buffer& buffer, std::ptrdiff_t& minGallop,
+                         Less& less) {
+    buffer.assign(std::make_move_iterator(base1), std::make_move_iterator(base1 + size1));
+    auto cursor1 = buffer.begin();     // Next element of the left run
+    RandomIt cursor2 = base2;          // Next element of the right run
+    RandomIt out = base1;              // Next slot written
+
+    // The right run's first element always goes first
+    *out++ = std::move(*cursor2++);
+    --size2;
+
+    while (size1 > 1 && size2 > 0) {
+        std::ptrdiff_t wins1 = 0;      // Left run wins in a row
+        std::ptrdiff_t wins2 = 0;      // Right run wins in a row
+
+        // One element at a time while neither run dominates
+        while (size1 > 1 && size2 > 0 && (wins1 | wins2) < minGallop) {
+            if (less(*cursor2, *cursor1)) {
+                *out++ = std::move(*cursor2++);
+                --size2;
+                ++wins2;
+                wins1 = 0;
+            }
+            else {
+                *out++ = std::move(*cursor1++);
+                --size1;
+                ++wins1;
+                wins2 = 0;
+            }
+        }
+        if (size1 <= 1 || size2 == 0) {
+            break;
+        }
+
+        // Gallop while it keeps paying off
+        ++minGallop;
+        do {
+            minGallop -= minGallop > 1;
+
+            wins1 = gallop_right(*cursor2, cursor1, size1, 0, less);
+            out = std::move(cursor1, cursor1 + wins1, out);
+            cursor1 += wins1;
+            size1 -= wins1;
+            if (size1 <= 1) {
+                break;
+            }
+            *out++ = std::move(*cursor2++);
+            if (--size2 == 0) {
+                break;
+            }
+
+            wins2 = gallop_left(*cursor1, cursor2, size2, 0, less);
+            out = std::move(cursor2, cursor2 + wins2, out);
+            cursor2 += wins2;
+            size2 -= wins2;
+            if (size2 == 0) {
+                break;
+            }
+            *out++ = std::move(*cursor1++);
+            if (--size1 <= 1) {
+                break;
+            }
+        } while (wins1 >= MIN_GALLOP || wins2 >= MIN_GALLOP);
+
+        // Penalize leaving galloping mode
+        if (size1 > 1 && size2 > 0) {
+            ++minGallop;
+        }
+    }
+
+    // The left run's last element goes after the rest of the right run
+    if (size1 == 1) {
+        out = std::move(cursor2, cursor2 + size2, out);
+        *out = std::move(*cursor1);
+    }
+    // The right run is used up
+    else {
+        std::move(cursor1, cursor1 + size1, out);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges two neighbouring runs back to front, the right one copied aside.
+// @param [in] base1 The beginning of the left run.
+// @param [in] size1 Length of the left run.
+// @param [in] base2 The beginning of the right run, right after the left.
+// @param [in] size2 Length of the right run, below size1.
+// @param [in] buffer Scratch storage, receives the right run.
+// @param [in] minGallop Galloping threshold, adapted to the merge.
+// @param [in] less The projected comparator.
+// @note Mirror image of tim_merge_low, filling the merged run from its end.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Buffer, class Less>
+void Sort::tim_merge_high(RandomIt base1, std::ptrdiff_t size1, RandomIt base2,
+                          std::ptrdiff_t size2, Buffer& buffer, std::ptrdiff_t& minGallop,
+                          Less& less) {
+    buffer.assign(std::make_move_iterator(base2), std::make_move_iterator(base2 + size2));
+    RandomIt cursor1 = base2;          // One past the next element of the left run
+    auto cursor2 = buffer.end();       // One past the next element of the right run
+    RandomIt out = base2 + size2;      // One past the next slot written
+
+    // The left run's last element always goes last
+    *--out = std::move(*--cursor1);
+    --size1;
+
+    while (size2 > 1 && size1 > 0) {
+        std::ptrdiff_t wins1 = 0;      // Left run wins in a row
+        std::ptrdiff_t wins2 = 0;      // Right run wins in a row
+
+        // One element at a time while neither run dominates
+        while (size2 > 1 && size1 > 0 && (wins1 | wins2) < minGallop) {
+            if (less(*(cursor2 - 1), *(cursor1 - 1))) {
+                *--out = std::move(*--cursor1);
+                --size1;
+                ++wins1;
+                wins2 = 0;
+            }
+            else {
+                *--out = std::move(*--cursor2);
+                --size2;
+                ++wins2;
+                wins1 = 0;
+            }
+        }
+        if (size2 <= 1 || size1 == 0) {
+            break;
+        }
+
+        // Gallop while it keeps paying off
+        ++minGallop;
+        do {
+            minGallop -= minGallop > 1;
+
+            wins1 = size1 - gallop_right(*(cursor2 - 1), base1, size1, size1 - 1, less);
+            out = std::move_backward(cursor1 - wins1, cursor1, out);
+            cursor1 -= wins1;
+            size1 -= wins1;
+            if (size1 == 0) {
+                break;
+            }
+            *--out = std::move(*--cursor2);
+            if (--size2 <= 1) {
+                break;
+            }
+
+            wins2 = size2 - gallop_left(*(cursor1 - 1), buffer.begin(), size2, size2 - 1, less);
+            out = std::move_backward(cursor2 - wins2, cursor2, out);
+            cursor2 -= wins2;
+            size2 -= wins2;
+            if (size2 <= 1) {
+                break;
+            }
+            *--out = std::move(*--cursor1);
+            if (--size1 == 0) {
+                break;
+            }
+        } while (wins1 >= MIN_GALLOP || wins2 >= MIN_GALLOP);
+
+        // Penalize leaving galloping mode
+        if (size2 > 1 && size1 > 0) {
+            ++minGallop;
+        }
+    }
+
+    // The right run's first element goes before the rest of the left run
+    if (size2 == 1) {
+        out = std::move_backward(cursor1 - size1, cursor1, out);
+        *--out = std::move(*--cursor2);
+    }
+    // The left run is used up
+    else {
+        std::move_backward(cursor2 - size2, cursor2, out);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Finds where a key goes in a sorted run, before any equal keys.
+// @param [in] key The key to place.
+// @param [in] base The beginning of the sorted run.
+// @param [in] size Length of the run, at least one.
+// @param [in] hint Position to search outwards from.
+// @param [in] less The projected comparator.
+// @note Steps of 1, 3, 7, 15, ... away from the hint bracket the position,
+// then a binary search narrows it down, so a key close to the hint costs
+// few comparisons.
+// @returns the number of run elements below the key.
+// ----------------------------------------------------------------------------
+template <class T, class InputIt, class Less>
+std::ptrdiff_t Sort::gallop_left(const T& key, InputIt base, std::ptrdiff_t size,
+                                 std::ptrdiff_t hint, Less& less) {
+    std::ptrdiff_t lastOffset = 0;     // The position is in (lastOffset, offset]
+    std::ptrdiff_t offset = 1;
+
+    // Key above the hint, gallop right
+    if (less(base[hint], key)) {
+        const std::ptrdiff_t maxOffset = size - hint;
+        while (offset < maxOffset && less(base[hint + offset], key)) {
+            lastOffset = offset;
+            offset = offset * 2 + 1;
+        }
+        offset = offset < maxOffset ? offset : maxOffset;
+        lastOffset += hint;
+        offset += hint;
+    }
+    // Key at or below the hint, gallop left
+    else {
+        const std::ptrdiff_t maxOffset = hint + 1;
+        while (offset < maxOffset && !less(base[hint - offset], key)) {
+            lastOffset = offset;
+            offset = offset * 2 + 1;
+        }
+        offset = offset < maxOffset ? offset : maxOffset;
+        const std::ptrdiff_t previous = lastOffset;
+        lastOffset = hint - offset;
+        offset = hint - previous;
+    }
+
+    // Binary search between the bracketing offsets
+    ++lastOffset;
+    while (lastOffset < offset) {
+        const std::ptrdiff_t middle = lastOffset + (offset - lastOffset) / 2;
+        if (less(base[middle], key)) {
+            lastOffset = middle + 1;
+        }
+        else {
+            offset = middle;
+        }
+    }
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Finds where a key goes in a sorted run, after any equal keys.
+// @param [in] key The key to place.
+// @param [in] base The beginning of the sorted run.
+// @param [in] size Length of the run, at least one.
+// @param [in] hint Position to search outwards from.
+// @param [in] less The projected comparator.
+// @note Same search as gallop_left, with equal keys counted before the key.
+// @returns the number of run elements at or below the key.
+// ----------------------------------------------------------------------------
+template <class T, class InputIt, class Less>
+std::ptrdiff_t Sort::gallop_right(const T& key, InputIt base, std::ptrdiff_t size,
+                                  std::ptrdiff_t hint, Less& less) {
+    std::ptrdiff_t lastOffset = 0;     // The position is in (lastOffset, offset]
+    std::ptrdiff_t offset = 1;
+
+    // Key below the hint, gallop left
+    if (less(key, base[hint])) {
+        const std::ptrdiff_t maxOffset = hint + 1;
+        while (offset < maxOffset && less(key, base[hint - offset])) {
+            lastOffset = offset;
+            offset = offset * 2 + 1;
+        }
+        offset = offset < maxOffset ? offset : maxOffset;
+        const std::ptrdiff_t previous = lastOffset;
+        lastOffset = hint - offset;
+        offset = hint - previous;
+    }
+    // Key at or above the hint, gallop right
+    else {
+        const std::ptrdiff_t maxOffset = size - hint;
+        while (offset < maxOffset && !less(key, base[hint + offset])) {
+            lastOffset = offset;
+            offset = offset * 2 + 1;
+        }
+        offset = offset < maxOffset ? offset : maxOffset;
+        lastOffset += hint;
+        offset += hint;
+    }
+
+    // Binary search between the bracketing offsets
+    ++lastOffset;
+    while (lastOffset < offset) {
+        const std::ptrdiff_t middle = lastOffset + (offset - lastOffset) / 2;
+        if (less(key, base[middle])) {
+            offset = middle;
+        }
+        else {
+            lastOffset = middle + 1;
+        }
+    }
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Performs merging of merge sort.
+// @param [in] first1 The beginning of the left sorted list.
+// @param [in] last1 One past the end of the left sorted list.
+// @param [in] first2 The beginning of the right sorted list.
+// @param [in] last2 One past the end of the right sorted list.
+// @param [out] out The beginning of the destination for the merged lists.
+// @param [in] less The projected comparator.
+// @note Equal keys are taken from the left list first, keeping it stable.
+// Trivially copyable elements are merged without branches.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class InputIt1, class InputIt2, class OutputIt, class Less>
+OutputIt Sort::merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+                     OutputIt out, Less& less) {
+    return merge(first1, last1, first2, last2, out, less,
+                 branchless_mergeable<InputIt1, InputIt2, OutputIt>());
+}
+
+// ----------------------------------------------------------------------------
+// Merges two sorted lists, branching on every comparison.
+// @param [in] first1 The beginning of the left sorted list.
+// @param [in] last1 One past the end of the left sorted list.
+// @param [in] first2 The beginning of the right sorted list.
+// @param [in] last2 One past the end of the right sorted list.
+// @param [out] out The beginning of the destination for the merged lists.
+// @param [in] less The projected comparator.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class InputIt1, class InputIt2, class OutputIt, class Less>
+OutputIt Sort::merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+                     OutputIt out, Less& less, std::false_type) {
+    while (first1 != last1 && first2 != last2) {
+        // Sort output with smaller value from left list.
+        if (!less(*first2, *first1)) {
+            *out = std::move(*first1);
+            ++first1;
+        }
+        // Sort output with smaller value from right list.
+        else {
+            *out = std::move(*first2);
+            ++first2;
+        }
+        ++out;
+    }
+
+    // Insert remaining elements from left list.
+    out = std::move(first1, last1, out);
+    // Insert remaining elements from right list.
+    return std::move(first2, last2, out);
+}
+
+// ----------------------------------------------------------------------------
+// Merges two sorted lists from both ends at once without branching.
+// @param [in] first1 The beginning of the left sorted list.
+// @param [in] last1 One past the end of the left sorted list.
+// @param [in] first2 The beginning of the right sorted list.
+// @param [in] last2 One past the end of the right sorted list.
+// @param [out] out The beginning of the destination for the merged lists.
+// @param [in] less The projected comparator.
+// @note Every step writes the smallest remaining element to the front and
+// the largest to the back, two independent dependency chains. Neither list
+// can run out within as many steps as the shorter list holds, so that many
+// steps need no bounds checks. The front takes equal keys from the left
+// list and the back from the right list, keeping it stable. What is left in
+// the middle is finished front to back.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class InputIt1, class InputIt2, class OutputIt, class Less>
+OutputIt Sort::merge(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+                     OutputIt out, Less& less, std::true_type) {
+    const std::ptrdiff_t size1 = last1 - first1;   // Left list length
+    const std::ptrdiff_t size2 = last2 - first2;   // Right list length
+    const std::ptrdiff_t steps = size1 < size2 ? size1 : size2;
+    OutputIt outLast = out + (size1 + size2);       // One past the back output
+
+    for (std::ptrdiff_t step = 0; step < steps; step++) {
+        // Smallest element to the front
+        const bool frontRight = less(*first2, *first1);
+        *out = frontRight ? *first2 : *first1;
+        first1 += !frontRight;
+        first2 += frontRight;
+        ++out;
+
+        // Largest element to the back
+        const bool backLeft = less(*(last2 - 1), *(last1 - 1));
+        *--outLast = backLeft ? *(last1 - 1) : *(last2 - 1);
+        last1 -= backLeft;
+        last2 -= !backLeft;
+    }
+
+    // The back holds as many elements as the front loop wrote
+    return merge_branchless(first1, last1, first2, last2, out, less) + steps;
+}
+
+// ----------------------------------------------------------------------------
+// Merges two sorted lists front to back without branching.
+// @param [in] first1 The beginning of the left sorted list.
+// @param [in] last1 One past the end of the left sorted list.
+// @param [in] first2 The beginning of the right sorted list.
+// @param [in] last2 One past the end of the right sorted list.
+// @param [out] out The beginning of the destination for the merged lists.
+// @param [in] less The projected comparator.
+// @note The comparison picks the element and advances the lists through
+// arithmetic, so the compiler emits conditional moves instead of a branch
+// that random data would mispredict half the time.
+// @returns one past the last element written.
+// ----------------------------------------------------------------------------
+template <class InputIt1, class InputIt2, class OutputIt, class Less>
+OutputIt Sort::merge_branchless(InputIt1 first1, InputIt1 last1, InputIt2 first2,
+                                InputIt2 last2, OutputIt out, Less& less) {
+    while (first1 != last1 && first2 != last2) {
+        const bool takeRight = less(*first2, *first1);
+        *out = takeRight ? *first2 : *first1;
+        first1 += !takeRight;
+        first2 += takeRight;
+        ++out;
+    }
+
+    out = std::copy(first1, last1, out);
+    return std::copy(first2, last2, out);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using merge sort across the workers of the shared pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+Sort::unless_pool<Compare, void> Sort::parallel_merge_sort(RandomIt first, RandomIt last,
+                                                          Compare comp, Projection proj) {
+    parallel_merge_sort(first, last, ThreadPool::instance(), std::move(comp), std::move(proj));
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using merge sort across the workers of a thread pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] pool The pool whose workers sort and merge.
+// @param [in] comp The comparator applied to the projected keys.
+// @param [in] proj The projection mapping an element to its sort key.
+// @note The range is cut into one chunk per worker. The workers move their
+// chunks into the scratch buffer and sort them back concurrently, then every round of pairwise merges is split again
+// across all workers by co-ranking the output (merge path). The final merge
+// is therefore parallel too.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Compare, class Projection>
+void Sort::parallel_merge_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+                               Compare comp, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    const std::ptrdiff_t size = last - first;                  // Elements to sort
+    const std::ptrdiff_t chunks = static_cast<std::ptrdiff_t>(pool.size());
+
+    // Not worth waking the workers
+    if (size < PARALLEL_CUTOFF || chunks < 2) {
+        merge_sort(first, last, std::move(comp), std::move(proj));
+        return;
+    }
+
+    auto less = make_less(std::move(comp), std::move(proj));
+
+    // Scratch buffer each chunk is sorted back from, trivial elements are
+    // moved in by the workers below.
+    auto scratch = scratch_buffer(first, last, std::is_trivial<value_type>());
+    value_type* buffer = &scratch[0];
+
+    // Chunk boundaries, run r spans [bounds[r], bounds[r + 1])
+    std::vector<std::ptrdiff_t> bounds;
+    for (std::ptrdiff_t chunk = 0; chunk <= chunks; chunk++) {
+        bounds.push_back(size * chunk / chunks);
+    }
+
+    // Every worker moves its own chunk in and sorts it back into the range.
+    pool.run(chunks, [&](std::size_t chunk) {
+        if (std::is_trivial<value_type>::value) {
+            std::move(first + bounds[chunk], first + bounds[chunk + 1], buffer + bounds[chunk]);
+        }
+        merge_sort_into(buffer + bounds[chunk], buffer + bounds[chunk + 1],
+                        first + bounds[chunk], less);
+    });
+
+    // Merge runs pairwise, alternating between range and buffer.
+    bool inRange = true;
+    while (bounds.size() > 2) {
+        if (inRange) {
+            parallel_merge_pass(first, buffer, bounds, pool, less);
+        }
+        else {
+            parallel_merge_pass(buffer, first, bounds, pool, less);
+        }
+        inRange = !inRange;
+    }
+
+    // Move the result back when the last round ended in the buffer.
+    if (!inRange) {
+        pool.run(chunks, [&](std::size_t chunk) {
+            std::move(buffer + size * chunk / chunks, buffer + size * (chunk + 1) / chunks,
+                      first + size * chunk / chunks);
+        });
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Merges every neighbouring pair of sorted runs using all workers.
+// @param [in] first The beginning of the runs.
+// @param [out] out The beginning of the destination, as long as the runs.
+// @param [in,out] bounds Run boundaries, replaced by the merged ones.
+// @param [in] pool The pool whose workers merge.
+// @param [in] less The projected comparator.
+// @note Each pair's output is cut into slices proportional to its length,
+// one per worker overall. The cuts are co-ranked before any worker starts,
+// since merging moves elements out of the runs the searches would read.
+// The slices then merge independently with no shared state.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Less>
+void Sort::parallel_merge_pass(InputIt first, OutputIt out,
+                               std::vector<std::ptrdiff_t>& bounds,
+                               ThreadPool& pool, Less& less) {
+    // One output slice of a merged pair
+    struct slice {
+        std::ptrdiff_t start;       // Start of the left run
+        std::ptrdiff_t split;       // Start of the right run
+        std::ptrdiff_t end;         // End of the right run
+        std::ptrdiff_t from;        // First output rank within the pair
+        std::ptrdiff_t to;          // One past the last output rank
+        std::ptrdiff_t leftFrom;    // Left elements before the first output rank
+        std::ptrdiff_t leftTo;      // Left elements before one past the last
+    };
+    const std::ptrdiff_t size = bounds.back() - bounds.front();
+    const std::ptrdiff_t workers = static_cast<std::ptrdiff_t>(pool.size());
+    std::vector<slice> slices;
+    std::vector<std::ptrdiff_t> merged;
+
+    for (std::size_t run = 0; run + 1 < bounds.size(); run += 2) {
+        // A lone trailing run pairs with an empty one and is moved across.
+        const std::ptrdiff_t start = bounds[run];
+        const std::ptrdiff_t split = bounds[run + 1];
+        const std::ptrdiff_t end = run + 2 < bounds.size() ? bounds[run + 2] : split;
+        const std::ptrdiff_t length = end - start;
+        const std::ptrdiff_t parts = (workers * length + size - 1) / size;
+
+        std::ptrdiff_t leftTo = 0;
+        for (std::ptrdiff_t part = 0; part < parts; part++) {
+            const std::ptrdiff_t from = length * part / parts;
+            const std::ptrdiff_t to = length * (part + 1) / parts;
+            const std::ptrdiff_t leftFrom = leftTo;
+            leftTo = co_rank(to, first + start, split - start, first + split, end - split, less);
+            slices.push_back({start, split, end, from, to, leftFrom, leftTo});
+        }
+        merged.push_back(start);
+    }
+    merged.push_back(bounds.back());
+
+    pool.run(slices.size(), [&](std::size_t index) {
+        const slice& task = slices[index];
+        merge(first + (task.start + task.leftFrom), first + (task.start + task.leftTo),
+              first + (task.split + task.from - task.leftFrom),
+              first + (task.split + task.to - task.leftTo),
+              out + (task.start + task.from), less);
+    });
+
+    bounds.swap(merged);
+}
+
+// ----------------------------------------------------------------------------
+// Splits a stable merge of two sorted lists at an output rank.
+// @param [in] rank Number of merged elements before the split.
+// @param [in] left The beginning of the left sorted list.
+// @param [in] leftSize Number of elements in the left list.
+// @param [in] right The beginning of the right sorted list.
+// @param [in] rightSize Number of elements in the right list.
+// @param [in] less The projected comparator.
+// @note Binary searches the merge path, the smallest count whose next left
+// element sorts after the right element it would be paired against.
+// @returns how many of the first rank merged elements come from the left.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Less>
+std::ptrdiff_t Sort::co_rank(std::ptrdiff_t rank, InputIt left, std::ptrdiff_t leftSize,
+                             InputIt right, std::ptrdiff_t rightSize, Less& less) {
+    std::ptrdiff_t low = rank > rightSize ? rank - rightSize : 0;
+    std::ptrdiff_t high = rank < leftSize ? rank : leftSize;
+
+    while (low < high) {
+        std::ptrdiff_t middle = low + (high - low) / 2;
+        if (less(*(right + (rank - 1 - middle)), *(left + middle))) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+
+    return low;
+}
+
+// ----------------------------------------------------------------------------
+// Splits a stable merge of k sorted runs at an output rank.
+// @param [in] rank Number of merged elements before the split.
+// @param [in] runs First and last pointer of every sorted run.
+// @param [out] splits Receives how many of the first rank merged elements
+// come from each run.
+// @param [in] less The projected comparator.
+// @note Keeps a window of possible splits per run. The middle element of
+// the widest window is ranked by binary searching every run, with equal
+// keys of earlier runs ahead of it and of later runs behind it. If fewer
+// than rank elements precede it, it and everything before it are inside
+// the split, otherwise it and everything after it are outside, so every
+// window shrinks to at most its search result. The widest window halves
+// each round, so selection takes O(k log n) rounds of k binary searches.
+// ----------------------------------------------------------------------------
+template <class T, class Less>
+void Sort::multi_co_rank(std::ptrdiff_t rank, const std::vector<std::pair<T*, T*>>& runs,
+                         std::vector<std::ptrdiff_t>& splits, Less& less) {
+    const std::size_t count = runs.size();          // Runs to split
+    std::vector<std::ptrdiff_t> high(count);        // Largest possible split per run
+    std::vector<std::ptrdiff_t> before(count);      // Elements preceding the pivot
+
+    splits.assign(count, 0);
+    for (std::size_t run = 0; run < count; run++) {
+        high[run] = runs[run].second - runs[run].first;
+    }
+
+    while (true) {
+        // Run with the widest window left
+        std::size_t widest = count;
+        std::ptrdiff_t width = 0;
+        for (std::size_t run = 0; run < count; run++) {
+            if (high[run] - splits[run] > width) {
+                width = high[run] - splits[run];
+                widest = run;
+            }
+        }
+        if (widest == count) {
+            return;
+        }
+
+        const std::ptrdiff_t middle = splits[widest] + width / 2;
+        const T& pivot = runs[widest].first[middle];
+        std::ptrdiff_t preceding = 0;
+
+        for (std::size_t run = 0; run < count; run++) {
+            if (run < widest) {
+                // Equal keys of an earlier run come first
+                before[run] = std::upper_bound(runs[run].first, runs[run].second, pivot,
+                                               [&less](const T& a, const T& b) {
+                                                   return less(a, b);
+                                               }) - runs[run].first;
+            }
+            else if (run > widest) {
+                before[run] = std::lower_bound(runs[run].first, runs[run].second, pivot,
+                                               [&less](const T& a, const T& b) {
+                                                   return less(a, b);
+                                               }) - runs[run].first;
+            }
+            else {
+                before[run] = middle;
+            }
+            preceding += before[run];
+        }
+
+        // Pivot inside the split, so is everything before it.
+        if (preceding < rank) {
+            for (std::size_t run = 0; run < count; run++) {
+                splits[run] = before[run] > splits[run] ? before[run] : splits[run];
+            }
+            splits[widest] = middle + 1;
+        }
+        // Pivot outside the split, so is everything after it.
+        else {
+            for (std::size_t run = 0; run < count; run++) {
+                high[run] = before[run] < high[run] ? before[run] : high[run];
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the least significant digit radix sort algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] proj The projection mapping an element to its integral key.
+// @note Keys are sorted in ascending order, one 11-bit digit per pass from
+// the lowest. The histograms of every digit are counted in a single pass, and
+// a digit shared by all keys is skipped. Passes ping-pong between the range
+// and one scratch buffer, so the sort is stable and takes O(N) extra memory.
+// Trivial elements are scattered from the range by the first pass, so an
+// odd number of passes needs no move back.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+void Sort::radix_sort(RandomIt first, RandomIt last, Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    static_assert(std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value,
+                  "radix_sort needs an integral key");
+
+    constexpr int passes = (sizeof(key_type) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+    const std::size_t size = last - first;         // Elements to sort
+
+    if (size < 2) {
+        return;
+    }
+
+    // Count every digit of every key in one pass over the range.
+    std::vector<std::size_t> counts(passes * RADIX_SIZE, 0);
+    for (RandomIt iterator = first; iterator != last; ++iterator) {
+        auto key = radix_key(proj(*iterator));
+        for (int pass = 0; pass < passes; pass++) {
+            counts[pass * RADIX_SIZE + ((key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1))]++;
+        }
+    }
+
+    // Keep the passes whose digit differs between keys, turning their
+    // counts into bucket offsets.
+    auto sample = radix_key(proj(*first));         // Any key, to find shared digits
+    std::vector<int> active;                       // Passes that move elements
+    for (int pass = 0; pass < passes; pass++) {
+        std::size_t* offsets = &counts[pass * RADIX_SIZE];
+        if (offsets[(sample >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)] == size) {
+            continue;
+        }
+        std::size_t total = 0;
+        for (std::size_t digit = 0; digit < RADIX_SIZE; digit++) {
+            std::size_t count = offsets[digit];
+            offsets[digit] = total;
+            total += count;
+        }
+        active.push_back(pass);
+    }
+    if (active.empty()) {
+        return;
+    }
+
+    // Scratch buffer, the passes alternate direction. Only elements that are
+    // not trivial start out in it, trivial ones are scattered in by the
+    // first pass.
+    auto scratch = scratch_buffer(first, last, std::is_trivial<value_type>());
+    value_type* buffer = &scratch[0];
+    bool inBuffer = !std::is_trivial<value_type>::value;    // Side holding the elements
+    for (int pass : active) {
+        std::size_t* offsets = &counts[pass * RADIX_SIZE];
+        if (inBuffer) {
+            radix_scatter(buffer, buffer + size, first, pass * RADIX_BITS, offsets, proj);
+        }
+        else {
+            radix_scatter(first, last, buffer, pass * RADIX_BITS, offsets, proj);
+        }
+        inBuffer = !inBuffer;
+    }
+    // Passes may leave the elements in the buffer.
+    if (inBuffer) {
+        std::move(buffer, buffer + size, first);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Maps an integral key to an unsigned key that sorts the same way.
+// @param [in] key The integral sort key.
+// @note Flipping the sign bit of a signed key moves the negative keys,
+// whose two's complement has it set, below the positive ones.
+// @returns the unsigned radix key.
+// ----------------------------------------------------------------------------
+template <class Key>
+typename std::make_unsigned<Key>::type Sort::radix_key(Key key) {
+    using unsigned_type = typename std::make_unsigned<Key>::type;
+    const unsigned_type signBit = std::is_signed<Key>::value
+                                ? unsigned_type(unsigned_type(1) << (sizeof(Key) * 8 - 1))
+                                : unsigned_type(0);
+
+    return static_cast<unsigned_type>(static_cast<unsigned_type>(key) ^ signBit);
+}
+
+// ----------------------------------------------------------------------------
+// Moves every element to the next free slot of its bucket for one digit.
+// @param [in] first The beginning of the elements to move.
+// @param [in] last One past the end of the elements to move.
+// @param [out] out The beginning of the destination, as long as the input.
+// @param [in] shift Position of the digit within the radix key.
+// @param [in] offsets Next free slot of each bucket, advanced as it fills.
+// @param [in] proj The projection mapping an element to its integral key.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Projection>
+void Sort::radix_scatter(InputIt first, InputIt last, OutputIt out, int shift,
+                         std::size_t* offsets, Projection& proj) {
+    for (; first != last; ++first) {
+        const std::size_t digit = (radix_key(proj(*first)) >> shift) & (RADIX_SIZE - 1);
+        *(out + offsets[digit]++) = std::move(*first);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range in place using the most significant digit radix sort
+// algorithm, also known as American flag sort.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] proj The projection mapping an element to its integral key.
+// @note Keys are sorted in ascending order, one byte per level from the
+// highest. Elements are swapped into their buckets along permutation cycles,
+// so apart from one set of bucket counts per level, at most one per key
+// byte, no memory is allocated. The sort is not stable.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+void Sort::msd_radix_sort(RandomIt first, RandomIt last, Projection proj) {
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    static_assert(std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value,
+                  "msd_radix_sort needs an integral key");
+    auto less = make_less(std::less<>(), std::move(proj));
+
+    // Shift of the highest digit, the lowest one may be partial
+    constexpr int digits = (sizeof(key_type) * 8 + MSD_RADIX_BITS - 1) / MSD_RADIX_BITS;
+    msd_radix_loop(first, last, (digits - 1) * MSD_RADIX_BITS, less);
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range whose keys already share their digits down to a shift,
+// continuing the MSD radix sort on the digit below it.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] shift Position of the lowest digit every key agrees on, as
+// returned by msd_radix_partition.
+// @param [in] proj The projection mapping an element to its integral key.
+// @note Finishes one bucket of msd_radix_partition without scanning the
+// digits it was split on again. A shift of 0 or less leaves nothing to sort.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+void Sort::msd_radix_sort(RandomIt first, RandomIt last, int shift, Projection proj) {
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    static_assert(std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value,
+                  "msd_radix_sort needs an integral key");
+    auto less = make_less(std::less<>(), std::move(proj));
+
+    if (shift > 0) {
+        msd_radix_loop(first, last, shift - MSD_RADIX_BITS, less);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Permutes a range in place into buckets by its highest differing key byte.
+// @param [in] first The beginning of the range of elements to partition.
+// @param [in] last One past the end of the range of elements to partition.
+// @param [out] bounds Receives the start of every bucket followed by the
+// range's length, only 0 and the length if every key is equal.
+// @param [in] proj The projection mapping an element to its integral key.
+// @note This is the first level of msd_radix_sort. Every key of a bucket
+// sorts before every key of the next, so sorting the buckets on their own,
+// in any order or at once, finishes the sort. Callers use it to tell the
+// whole range scan apart from the work local to a bucket. The keys of a
+// bucket share every digit down to the returned shift, so msd_radix_sort
+// given that shift finishes a bucket from the next lower digit.
+// @returns the shift of the digit split on, -1 if every key is equal.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+int Sort::msd_radix_partition(RandomIt first, RandomIt last, std::vector<std::size_t>& bounds,
+                              Projection proj) {
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    static_assert(std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value,
+                  "msd_radix_partition needs an integral key");
+    auto less = make_less(std::less<>(), std::move(proj));
+    const std::size_t size = static_cast<std::size_t>(last - first);
+    std::size_t counts[MSD_RADIX_SIZE];            // Elements per bucket
+    int shift = -1;                                // Digit split on
+
+    constexpr int digits = (sizeof(key_type) * 8 + MSD_RADIX_BITS - 1) / MSD_RADIX_BITS;
+    bounds.assign(1, 0);
+    if (size > 1) {
+        shift = msd_radix_split(first, last, (digits - 1) * MSD_RADIX_BITS, counts, less);
+    }
+    if (shift >= 0) {
+        for (std::size_t bucket = 0; bucket < MSD_RADIX_SIZE; bucket++) {
+            bounds.push_back(bounds.back() + counts[bucket]);
+        }
+    }
+    else {
+        bounds.push_back(size);
+    }
+    return shift;
+}
+
+// ----------------------------------------------------------------------------
+// Permutes a range into buckets by one digit and recurses into each bucket.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] shift Position of the digit within the radix key.
+// @param [in] less The projected comparator, whose projection gives the key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+void Sort::msd_radix_loop(RandomIt first, RandomIt last, int shift, Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+    std::size_t counts[MSD_RADIX_SIZE];            // Elements per bucket
+
+    // Small bucket
+    if (size <= MSD_RADIX_CUTOFF) {
+        if (size > 1) {
+            intro_sort_loop(first, last, 2 * log2_floor(size), Partition::block, true, less);
+        }
+        return;
+    }
+
+    shift = msd_radix_split(first, last, shift, counts, less);
+
+    // Recurse into every bucket on the next lower digit
+    if (shift > 0) {
+        RandomIt bucketBegin = first;              // Start of the current bucket
+        for (std::size_t bucket = 0; bucket < MSD_RADIX_SIZE; bucket++) {
+            RandomIt bucketEnd = bucketBegin + counts[bucket];
+            msd_radix_loop(bucketBegin, bucketEnd, shift - MSD_RADIX_BITS, less);
+            bucketBegin = bucketEnd;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Permutes a range into buckets by one digit.
+// @param [in] first The beginning of the range, not empty.
+// @param [in] last One past the end of the range.
+// @param [in] shift Position of the highest digit to try.
+// @param [out] counts Receives the elements per bucket.
+// @param [in] less The projected comparator, whose projection gives the key.
+// @note Digits every key shares are skipped, each costing one counting scan.
+// @returns the shift of the digit split on, -1 if every key is equal.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Less>
+int Sort::msd_radix_split(RandomIt first, RandomIt last, int shift, std::size_t* counts,
+                          Less& less) {
+    const std::ptrdiff_t size = last - first;      // Elements to permute
+    std::size_t heads[MSD_RADIX_SIZE];             // Next unplaced slot per bucket
+
+    auto digit = [&less, &shift](const auto& value) {
+        return static_cast<std::size_t>(
+            (radix_key(less.proj(value)) >> shift) & (MSD_RADIX_SIZE - 1));
+    };
+
+    // Count the bucket sizes, moving straight on to the next digit while
+    // every key shares this one.
+    while (true) {
+        std::fill(counts, counts + MSD_RADIX_SIZE, 0);
+        for (RandomIt iterator = first; iterator != last; ++iterator) {
+            counts[digit(*iterator)]++;
+        }
+        if (counts[digit(*first)] != static_cast<std::size_t>(size)) {
+            break;
+        }
+        if (shift == 0) {
+            return -1;
+        }
+        shift -= MSD_RADIX_BITS;
+    }
+
+    // Start of every bucket
+    std::size_t total = 0;
+    for (std::size_t bucket = 0; bucket < MSD_RADIX_SIZE; bucket++) {
+        heads[bucket] = total;
+        total += counts[bucket];
+    }
+
+    // Fill the buckets in order. The element at a bucket's next unplaced slot
+    // is carried along the cycle of slots it displaces until an element of
+    // that bucket comes back to fill it.
+    std::size_t end = 0;                           // End of the current bucket
+    for (std::size_t bucket = 0; bucket < MSD_RADIX_SIZE; bucket++) {
+        end += counts[bucket];
+        while (heads[bucket] < end) {
+            auto value = std::move(*(first + heads[bucket]));
+            std::size_t target = digit(value);      // Bucket of the carried element
+
+            while (target != bucket) {
+                std::swap(value, *(first + heads[target]++));
+                target = digit(value);
+            }
+            *(first + heads[bucket]++) = std::move(value);
+        }
+    }
+    return shift;
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the parallel radix sort algorithm on the shared pool.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] proj The projection mapping an element to its integral key.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+Sort::unless_pool<Projection, void> Sort::parallel_radix_sort(RandomIt first, RandomIt last,
+                                                              Projection proj) {
+    parallel_radix_sort(first, last, ThreadPool::instance(), std::move(proj));
+}
+
+// ----------------------------------------------------------------------------
+// Sorts a range using the parallel least significant digit radix sort
+// algorithm.
+// @param [in] first The beginning of the range of elements to sort.
+// @param [in] last One past the end of the range of elements to sort.
+// @param [in] pool The thread pool whose workers sort the range.
+// @param [in] proj The projection mapping an element to its integral key.
+// @note The range is cut into one slice per worker. Every pass each worker
+// counts the digits of its slice, a prefix sum over the bucket major, slice
+// minor counts then hands every worker its own write offsets in each bucket,
+// and the workers scatter their slices at once. The first pass scatters
+// trivial elements straight from the range into uninitialized scratch, so
+// no thread copies the range on its own. Small elements are staged per
+// bucket in cache line sized write-combining buffers, one set per worker
+// allocated once for every pass, so the scatter writes whole lines. Like
+// radix_sort it is stable and skips passes whose digit every key shares.
+// ----------------------------------------------------------------------------
+template <class RandomIt, class Projection>
+void Sort::parallel_radix_sort(RandomIt first, RandomIt last, ThreadPool& pool,
+                               Projection proj) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using key_type = typename std::decay<decltype(proj(*first))>::type;
+    static_assert(std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value,
+                  "parallel_radix_sort needs an integral key");
+    // Whether elements can be staged in write-combining buffers
+    using combined = std::integral_constant<bool, std::is_trivial<value_type>::value
+                                                  && sizeof(value_type) < CACHE_LINE_BYTES>;
+    // Element of the staging lines, unused unless elements are staged
+    using staged = typename std::conditional<combined::value, value_type, char>::type;
+    constexpr std::size_t lineElements = CACHE_LINE_BYTES / sizeof(value_type);
+
+    constexpr int passes = (sizeof(key_type) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+    const std::ptrdiff_t size = last - first;      // Elements to sort
+    const std::size_t slices = pool.size();        // One slice per worker
+
+    // Too small to share out
+    if (slices == 1 || size < PARALLEL_CUTOFF * static_cast<std::ptrdiff_t>(slices)) {
+        radix_sort(first, last, std::move(proj));
+        return;
+    }
+
+    // Start of a slice, the last one ends at the range's end
+    auto sliceBegin = [size, slices](std::size_t slice) {
+        return static_cast<std::ptrdiff_t>(size * slice / slices);
+    };
+
+    // Scratch buffer, the passes alternate direction. Only elements that are
+    // not trivial start out in it.
+    auto scratch = scratch_buffer(first, last, std::is_trivial<value_type>());
+    value_type* buffer = &scratch[0];
+    bool inBuffer = !std::is_trivial<value_type>::value;    // Side holding the elements
+    std::vector<std::size_t> offsets(slices * RADIX_SIZE);  // Counts, then write offsets
+    // One line per bucket for every worker
+    std::vector<staged> staging(combined::value ? slices * RADIX_SIZE * lineElements : 0);
+
+    for (int pass = 0; pass < passes; pass++) {
+        const int shift = pass * RADIX_BITS;       // Position of the digit
+
+        // Every worker counts the digits of its own slice.
+        pool.run(slices, [&](std::size_t slice) {
+            std::size_t* counts = &offsets[slice * RADIX_SIZE];
+            std::fill(counts, counts + RADIX_SIZE, 0);
+            if (inBuffer) {
+                radix_count(buffer + sliceBegin(slice), buffer + sliceBegin(slice + 1),
+                            shift, counts, proj);
+            }
+            else {
+                radix_count(first + sliceBegin(slice), first + sliceBegin(slice + 1),
+                            shift, counts, proj);
+            }
+        });
+
+        // Buckets in order, and the slices in order within a bucket, keep
+        // the sort stable.
+        std::size_t total = 0;                     // Elements placed so far
+        bool shared = false;                       // Every key has the same digit
+        for (std::size_t bucket = 0; bucket < RADIX_SIZE; bucket++) {
+            const std::size_t bucketBegin = total;
+            for (std::size_t slice = 0; slice < slices; slice++) {
+                std::size_t count = offsets[slice * RADIX_SIZE + bucket];
+                offsets[slice * RADIX_SIZE + bucket] = total;
+                total += count;
+            }
+            shared = shared || total - bucketBegin == static_cast<std::size_t>(size);
+        }
+        if (shared) {
+            continue;
+        }
+
+        // Every worker scatters its slice to its own offsets.
+        pool.run(slices, [&](std::size_t slice) {
+            std::size_t* slots = &offsets[slice * RADIX_SIZE];
+            staged* lines = staging.data() + slice * RADIX_SIZE * lineElements;
+            if (inBuffer) {
+                radix_scatter_combined(buffer + sliceBegin(slice), buffer + sliceBegin(slice + 1),
+                                       first, shift, slots, proj, lines, combined());
+            }
+            else {
+                radix_scatter_combined(first + sliceBegin(slice), first + sliceBegin(slice + 1),
+                                       buffer, shift, slots, proj, lines, combined());
+            }
+        });
+        inBuffer = !inBuffer;
+    }
+
+    // Passes may leave the elements in the buffer.
+    if (inBuffer) {
+        pool.run(slices, [&](std::size_t slice) {
+            std::move(buffer + sliceBegin(slice), buffer + sliceBegin(slice + 1),
+                      first + sliceBegin(slice));
+        });
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Counts the elements of a range falling in each bucket for one digit.
+// @param [in] first The beginning of the elements to count.
+// @param [in] last One past the end of the elements to count.
+// @param [in] shift Position of the digit within the radix key.
+// @param [in] counts Bucket counts, incremented for every element.
+// @param [in] proj The projection mapping an element to its integral key.
+// ----------------------------------------------------------------------------
+template <class InputIt, class Projection>
+void Sort::radix_count(InputIt first, InputIt last, int shift, std::size_t* counts,
+                       Projection& proj) {
+    for (; first != last; ++first) {
+        counts[(radix_key(proj(*first)) >> shift) & (RADIX_SIZE - 1)]++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Moves every element to the next free slot of its bucket for one digit,
+// for elements too large or complex to stage.
+// @param [in] first The beginning of the elements to move.
+// @param [in] last One past the end of the elements to move.
+// @param [out] out The beginning of the destination.
+// @param [in] shift Position of the digit within the radix key.
+// @param [in] offsets Next free slot of each bucket, advanced as it fills.
+// @param [in] proj The projection mapping an element to its integral key.
+// @param [in] staging Unused, nothing is staged.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Projection, class Staged>
+void Sort::radix_scatter_combined(InputIt first, InputIt last, OutputIt out, int shift,
+                                  std::size_t* offsets, Projection& proj, Staged* staging,
+                                  std::false_type) {
+    (void)staging;
+    radix_scatter(first, last, out, shift, offsets, proj);
+}
+
+// ----------------------------------------------------------------------------
+// Moves every element to the next free slot of its bucket for one digit,
+// staging each bucket in a cache line sized write-combining buffer.
+// @param [in] first The beginning of the elements to move.
+// @param [in] last One past the end of the elements to move.
+// @param [out] out The beginning of the destination.
+// @param [in] shift Position of the digit within the radix key.
+// @param [in] offsets Next free slot of each bucket, advanced as it fills.
+// @param [in] proj The projection mapping an element to its integral key.
+// @param [in] staging One line of room per bucket, kept by the caller across
+// passes.
+// @note A bucket's buffer is flushed once full, so the destination sees
+// whole line writes instead of one scattered store per element. The first
+// flush of a bucket stops at the next line boundary of the destination, which
+// keeps the later flushes line aligned.
+// ----------------------------------------------------------------------------
+template <class InputIt, class OutputIt, class Projection, class Staged>
+void Sort::radix_scatter_combined(InputIt first, InputIt last, OutputIt out, int shift,
+                                  std::size_t* offsets, Projection& proj, Staged* staging,
+                                  std::true_type) {
+    using value_type = typename std::iterator_traits<InputIt>::value_type;
+    constexpr std::size_t lineElements = CACHE_LINE_BYTES / sizeof(value_type);
+
+    std::size_t filled[RADIX_SIZE] = {};                        // Staged per bucket
+    std::size_t room[RADIX_SIZE];                               // Staged before a flush
+    std::fill(room, room + RADIX_SIZE, lineElements);
+
+    // Line offset of the destination, only meaningful when elements tile a line
+    if (CACHE_LINE_BYTES % sizeof(value_type) == 0) {
+        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(std::addressof(*out))
+                                  / sizeof(value_type);
+        for (std::size_t bucket = 0; bucket < RADIX_SIZE; bucket++) {
+            room[bucket] = lineElements - (base + offsets[bucket]) % lineElements;
+        }
+    }
+
+    for (; first != last; ++first) {
+        const std::size_t digit = (radix_key(proj(*first)) >> shift) & (RADIX_SIZE - 1);
+        value_type* line = &staging[digit * lineElements];
+
+        line[filled[digit]++] = *first;
+        // Full line, write it out whole
+        if (filled[digit] == room[digit]) {
+            std::copy(line, line + filled[digit], out + offsets[digit]);
+            offsets[digit] += filled[digit];
+            filled[digit] = 0;
+            room[digit] = lineElements;
+        }
+    }
+
+    // Flush the partly filled lines
+    for (std::size_t bucket = 0; bucket < RADIX_SIZE; bucket++) {
+        value_type* line = &staging[bucket * lineElements];
+        std::copy(line, line + filled[bucket], out + offsets[bucket]);
+        offsets[bucket] += filled[bucket];
     }
 }
 
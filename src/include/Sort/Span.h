@@ -0,0 +1,132 @@
+/// @file: Span.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements a non-owning view of a contiguous sequence,
+/// a pointer and a length, so sorted runs living in vectors, arrays or
+/// mapped files can be handed to the merging algorithms without a copy.
+
+#ifndef SPAN_H_
+#define SPAN_H_
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/// ----------------------------------------------------------------------------
+///                                Span Class
+/// ----------------------------------------------------------------------------
+template <class T>
+class Span {
+public:
+	using value_type = typename std::remove_cv<T>::type;
+	using iterator = T*;
+
+	// Empty span
+	constexpr Span() noexcept;
+	// Span over count elements starting at data
+	constexpr Span(T* data, std::size_t count) noexcept;
+	// Span over [first, last)
+	constexpr Span(T* first, T* last) noexcept;
+	// Span over a whole vector, const spans accept const vectors
+	template <class Allocator>
+	Span(std::vector<value_type, Allocator>& vector) noexcept;
+	template <class Allocator, class U = T,
+	          class = typename std::enable_if<std::is_const<U>::value>::type>
+	Span(const std::vector<value_type, Allocator>& vector) noexcept;
+	// Read-only span over a mutable one
+	template <class U, class = typename std::enable_if<
+		std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+	constexpr Span(const Span<U>& other) noexcept;
+
+	constexpr T* data() const noexcept;
+	constexpr std::size_t size() const noexcept;
+	constexpr bool empty() const noexcept;
+	constexpr T* begin() const noexcept;
+	constexpr T* end() const noexcept;
+	constexpr T& operator[](std::size_t index) const noexcept;
+
+private:
+	T* first;               ///< First element
+	std::size_t count;      ///< Number of elements
+};
+
+// ----------------------------------------------------------------------------
+// Builds an empty span.
+// ----------------------------------------------------------------------------
+template <class T>
+constexpr Span<T>::Span() noexcept : first(nullptr), count(0) {}
+
+// ----------------------------------------------------------------------------
+// Builds a span over count elements.
+// @param [in] data The first element.
+// @param [in] count Number of elements.
+// ----------------------------------------------------------------------------
+template <class T>
+constexpr Span<T>::Span(T* data, std::size_t count) noexcept : first(data), count(count) {}
+
+// ----------------------------------------------------------------------------
+// Builds a span over a pointer range.
+// @param [in] first The first element.
+// @param [in] last One past the last element.
+// ----------------------------------------------------------------------------
+template <class T>
+constexpr Span<T>::Span(T* first, T* last) noexcept
+    : first(first), count(static_cast<std::size_t>(last - first)) {}
+
+// ----------------------------------------------------------------------------
+// Builds a span over every element of a vector.
+// @param [in] vector The vector, which must outlive the span and not grow.
+// ----------------------------------------------------------------------------
+template <class T>
+template <class Allocator>
+Span<T>::Span(std::vector<value_type, Allocator>& vector) noexcept
+    : first(vector.data()), count(vector.size()) {}
+
+template <class T>
+template <class Allocator, class U, class>
+Span<T>::Span(const std::vector<value_type, Allocator>& vector) noexcept
+    : first(vector.data()), count(vector.size()) {}
+
+// ----------------------------------------------------------------------------
+// Builds a read-only span over the elements of a mutable one.
+// @param [in] other The mutable span.
+// ----------------------------------------------------------------------------
+template <class T>
+template <class U, class>
+constexpr Span<T>::Span(const Span<U>& other) noexcept
+    : first(other.data()), count(other.size()) {}
+
+// ----------------------------------------------------------------------------
+// Accessors, none of them check bounds.
+// ----------------------------------------------------------------------------
+template <class T>
+constexpr T* Span<T>::data() const noexcept {
+    return first;
+}
+
+template <class T>
+constexpr std::size_t Span<T>::size() const noexcept {
+    return count;
+}
+
+template <class T>
+constexpr bool Span<T>::empty() const noexcept {
+    return count == 0;
+}
+
+template <class T>
+constexpr T* Span<T>::begin() const noexcept {
+    return first;
+}
+
+template <class T>
+constexpr T* Span<T>::end() const noexcept {
+    return first + count;
+}
+
+template <class T>
+constexpr T& Span<T>::operator[](std::size_t index) const noexcept {
+    return first[index];
+}
+
+#endif  /* SPAN_H_ */
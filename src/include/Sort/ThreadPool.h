@@ -0,0 +1,236 @@
+/// @file: ThreadPool.h
+/// @author: Sao Thao
+/// @date: 2022-31-08
+/// @note: This class implements a persistent pool of worker threads shared
+/// by the parallel sorting algorithms, so threads are started once rather
+/// than on every sort, along with the locked deques used for work stealing.
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/// ----------------------------------------------------------------------------
+///                             ThreadPool Class
+/// ----------------------------------------------------------------------------
+class ThreadPool {
+public:
+	// Starts the worker threads, one per hardware thread by default
+	explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+	// Finishes the queued tasks and joins the worker threads
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of worker threads
+	std::size_t size() const;
+	// Queues a task and returns a future that completes with it
+	template <class Function>
+	std::future<void> submit(Function task);
+	// Runs task(index) for every index below count across the workers and waits
+	template <class Function>
+	void run(std::size_t count, Function task);
+	// Process wide pool used when a sort is not handed one explicitly
+	static ThreadPool& instance();
+
+private:
+	// Worker thread body, runs queued tasks until the pool stops
+	void worker_loop();
+
+	std::vector<std::thread> workers;               ///< Worker threads
+	std::queue<std::function<void()>> tasks;        ///< Pending tasks
+	std::mutex mutex;                               ///< Guards tasks and stopping
+	std::condition_variable ready;                  ///< Signals new tasks
+	bool stopping;                                  ///< Set on destruction
+};
+
+// ----------------------------------------------------------------------------
+// Starts the worker threads.
+// @param [in] threads Number of workers, at least one is always started.
+// ----------------------------------------------------------------------------
+inline ThreadPool::ThreadPool(std::size_t threads) : stopping(false) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (std::size_t index = 0; index < threads; index++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Finishes the queued tasks and joins the worker threads.
+// ----------------------------------------------------------------------------
+inline ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Number of worker threads in the pool.
+// @returns the worker count.
+// ----------------------------------------------------------------------------
+inline std::size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+// ----------------------------------------------------------------------------
+// Queues a task for the next idle worker.
+// @param [in] task Callable taking no arguments.
+// @returns a future that becomes ready, or rethrows, once the task ran.
+// ----------------------------------------------------------------------------
+template <class Function>
+std::future<void> ThreadPool::submit(Function task) {
+    // Shared so the queued std::function stays copyable
+    auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace([packaged]() { (*packaged)(); });
+    }
+    ready.notify_one();
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Runs task(index) for every index in [0, count) on the workers and waits.
+// @param [in] count Number of indices to run.
+// @param [in] task Callable taking a std::size_t index.
+// @note Every worker claims indices from a shared counter, so uneven tasks
+// balance themselves. Must not be called from inside a pool task, since the
+// caller blocks until the workers are done.
+// ----------------------------------------------------------------------------
+template <class Function>
+void ThreadPool::run(std::size_t count, Function task) {
+    std::atomic<std::size_t> next(0);       // Next unclaimed index
+    std::vector<std::future<void>> done;    // One per participating worker
+    const std::size_t helpers = count < size() ? count : size();
+
+    for (std::size_t helper = 0; helper < helpers; helper++) {
+        done.push_back(submit([&next, count, &task]() {
+            for (std::size_t index = next++; index < count; index = next++) {
+                task(index);
+            }
+        }));
+    }
+    // Wait for every worker before rethrowing, they refer to this frame.
+    for (auto& future : done) {
+        future.wait();
+    }
+    for (auto& future : done) {
+        future.get();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Process wide pool with one worker per hardware thread.
+// @returns the shared pool, started on first use.
+// ----------------------------------------------------------------------------
+inline ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// ----------------------------------------------------------------------------
+// Runs queued tasks until the pool is stopped and the queue is drained.
+// ----------------------------------------------------------------------------
+inline void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;     // Task taken from the queue
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+/// ----------------------------------------------------------------------------
+///                           LockedDeque Class
+/// ----------------------------------------------------------------------------
+/// Task deque for work stealing guarded by one mutex. The owner and thieves
+/// take the same lock, so it is not the lock-free Chase-Lev deque: a pop can
+/// wait behind a steal. Callers push only tasks worth far more than a lock,
+/// so the lock never dominates.
+template <class T>
+class LockedDeque {
+public:
+	// Adds a task at the owner's end
+	void push(T task);
+	// Takes the newest task from the owner's end
+	bool pop(T& task);
+	// Takes the oldest task from the thieves' end
+	bool steal(T& task);
+
+private:
+	std::deque<T> tasks;            ///< Pending tasks, oldest first
+	std::mutex mutex;               ///< Guards tasks
+};
+
+// ----------------------------------------------------------------------------
+// Adds a task at the owner's end of the deque.
+// @param [in] task The task to add.
+// ----------------------------------------------------------------------------
+template <class T>
+void LockedDeque<T>::push(T task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+}
+
+// ----------------------------------------------------------------------------
+// Takes the newest task, the one most likely still in the owner's cache.
+// @param [out] task Receives the task.
+// @returns true if a task was taken.
+// ----------------------------------------------------------------------------
+template <class T>
+bool LockedDeque<T>::pop(T& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+        return false;
+    }
+    task = std::move(tasks.back());
+    tasks.pop_back();
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Takes the oldest task, for divide and conquer work usually the largest.
+// @param [out] task Receives the task.
+// @returns true if a task was taken.
+// ----------------------------------------------------------------------------
+template <class T>
+bool LockedDeque<T>::steal(T& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+        return false;
+    }
+    task = std::move(tasks.front());
+    tasks.pop_front();
+    return true;
+}
+
+#endif  /* THREADPOOL_H_ */